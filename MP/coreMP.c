@@ -13,12 +13,29 @@
 // time step arrays
 double *previousStep, *currentStep, *nextStep;
 
+// minimum and maximum pyramid of the current values for the visualisation
+double *pyramid;
+int pyramidLevels;
+int pyramidOffsets[LOD_MAX_LEVELS], pyramidCounts[LOD_MAX_LEVELS];
+
 // setting values
-int intervalEnd, nPoints, tPoints, periods, amplitude, useGui, printvalues, doBenchmark;
+int intervalEnd, nPoints, tPoints, periods, amplitude, useGui, printvalues, doBenchmark, doTuning, stepsPerSecond, waterfallStride, renderInterval;
+char renderOutput[MAX_PATH_LENGTH];
+
+// shared memory for external viewers
+char publishName[MAX_PATH_LENGTH];
+int publishInterval;
+
+// session of the visualisation to record, or to replay without it
+char recordFile[MAX_PATH_LENGTH], replayFile[MAX_PATH_LENGTH];
+SharedWave *sharedWave;
 
 const double DELTA_T = 1.0;
 double deltaX, lambda, c, cSquared, waveSpeed;
 
+// kernel parameters, possibly loaded from the tuning database
+KernelConfig kernelConfig;
+
 void outputHelpMessage()
 {
     printf("\nHOW TO USE:\n");
@@ -34,9 +51,18 @@ void outputHelpMessage()
     printf("\tAMPLITUDE\t\tThe amplitude of the sine wave\t\t\t\t\tLINE_INTERVAL_END / 4\n");
     printf("\tLAMBDA\t\t\tThe damping factor for the sine wave\t\t\t\t0 (no damping)\n");
     printf("\tSHOW_GUI\t\tShow the visualisation of the wave\t\t\t\t1 (true)\n");
-    printf("\tPRINT_VALUES\t\tPrint final values to console\t\t\t\t\t0 (false)\n\n");
-    printf("From cmd line: './myWaveMP [-s SPEED] [-t TIMESTEPS] [-i INTERVALEND] [-n POINTS] [-p PERIODS] [-a AMPLITUDE] [-l LAMBDA] [-u SHOWGUI] [-v PRINTVALUES]'\n\n");
+    printf("\tPRINT_VALUES\t\tPrint final values to console\t\t\t\t\t0 (false)\n");
+    printf("\tSTEPS_PER_SECOND\tTime steps per second in the visualisation, 0 for full speed\t0\n");
+    printf("\tWATERFALL_STRIDE\tTime steps between two rows of the waterfall view\t\t%d\n", DEFAULT_WATERFALL_STRIDE);
+    printf("\tRENDER_INTERVAL\t\tRender an image without window every this many time steps\t0 (off)\n");
+    printf("\tRENDER_OUTPUT\t\tFile name prefix of the images, raw RGB stream if it ends with %s\t%s\n", RAW_RENDER_SUFFIX, DEFAULT_RENDER_OUTPUT);
+    printf("\tPUBLISH_NAME\t\tName of the shared memory for external viewers (no GUI)\t\t(off)\n");
+    printf("\tPUBLISH_INTERVAL\tTime steps between two frames in the shared memory\t\t%d\n", DEFAULT_PUBLISH_INTERVAL);
+    printf("\tRECORD_FILE\t\tRecord the events of the visualisation with their time steps\t(off)\n");
+    printf("\tREPLAY_FILE\t\tReplay a recorded session without window at full speed\t\t(off)\n\n");
+    printf("From cmd line: './myWaveMP [-s SPEED] [-t TIMESTEPS] [-i INTERVALEND] [-n POINTS] [-p PERIODS] [-a AMPLITUDE] [-l LAMBDA] [-u SHOWGUI] [-v PRINTVALUES] [-S STEPSPERSECOND] [-W WATERFALL_STRIDE] [-E RENDER_INTERVAL] [-O RENDER_OUTPUT] [-P PUBLISH_NAME] [-I PUBLISH_INTERVAL] [--record RECORD_FILE] [--replay REPLAY_FILE]'\n\n");
     printf("To perform benchmarks, use './myWaveMP -b TIMESTEPS POINTS' or './myWaveMP --benchmark TIMESTEPS POINTS'\n");
+    printf("To tune the kernel for this machine, use './myWaveMP -T POINTS' or './myWaveMP --tune POINTS'\n");
     printf("To show this message, use './myWaveMP -h' or './myWaveMP --help'\n");
 }
 
@@ -122,6 +148,38 @@ void getFromSettingsFile(char *configPath)
         {
             printvalues = atoi(configValue);
         }
+        else if (0 == strcmp(configKey, "STEPS_PER_SECOND"))
+        {
+            stepsPerSecond = atoi(configValue);
+        }
+        else if (0 == strcmp(configKey, "WATERFALL_STRIDE"))
+        {
+            waterfallStride = atoi(configValue);
+        }
+        else if (0 == strcmp(configKey, "RENDER_INTERVAL"))
+        {
+            renderInterval = atoi(configValue);
+        }
+        else if (0 == strcmp(configKey, "RENDER_OUTPUT"))
+        {
+            snprintf(renderOutput, MAX_PATH_LENGTH, "%s", configValue);
+        }
+        else if (0 == strcmp(configKey, "PUBLISH_NAME"))
+        {
+            snprintf(publishName, MAX_PATH_LENGTH, "%s", configValue);
+        }
+        else if (0 == strcmp(configKey, "PUBLISH_INTERVAL"))
+        {
+            publishInterval = atoi(configValue);
+        }
+        else if (0 == strcmp(configKey, "RECORD_FILE"))
+        {
+            snprintf(recordFile, MAX_PATH_LENGTH, "%s", configValue);
+        }
+        else if (0 == strcmp(configKey, "REPLAY_FILE"))
+        {
+            snprintf(replayFile, MAX_PATH_LENGTH, "%s", configValue);
+        }
         else
         {
             printf("[INFO] Unrecognized settings key: '%s'\n", configKey);
@@ -178,6 +236,32 @@ void getFromCmdLine(int nargc, char **argv)
             exit(EXIT_FAILURE);
         }
     }
+    else if (0 == strcmp(argv[1], "-T") || 0 == strcmp(argv[1], "--tune"))
+    {
+
+        if (nargc == 3)
+        {
+
+            doTuning = 1;
+
+            // only the number of points can be set for tuning
+            // all other values are default
+            nPoints = atoi(argv[2]);
+
+            // one point per unit of length, with the default interval end deltaX would be 0 for many points
+            intervalEnd = nPoints;
+
+            // visualization is disabled
+            useGui = 0;
+        }
+        else
+        {
+
+            // print help message and exit
+            outputHelpMessage();
+            exit(EXIT_FAILURE);
+        }
+    }
     else
     {
 
@@ -230,6 +314,46 @@ void getFromCmdLine(int nargc, char **argv)
 
                 printvalues = atoi(argv[++i]);
             }
+            else if (0 == strcmp(argv[i], "-S") || 0 == strcmp(argv[i], "--steps-per-second"))
+            {
+
+                stepsPerSecond = atoi(argv[++i]);
+            }
+            else if (0 == strcmp(argv[i], "-W") || 0 == strcmp(argv[i], "--waterfall-stride"))
+            {
+
+                waterfallStride = atoi(argv[++i]);
+            }
+            else if (0 == strcmp(argv[i], "-E") || 0 == strcmp(argv[i], "--render-interval"))
+            {
+
+                renderInterval = atoi(argv[++i]);
+            }
+            else if (0 == strcmp(argv[i], "-O") || 0 == strcmp(argv[i], "--render-output"))
+            {
+
+                snprintf(renderOutput, MAX_PATH_LENGTH, "%s", argv[++i]);
+            }
+            else if (0 == strcmp(argv[i], "-P") || 0 == strcmp(argv[i], "--publish"))
+            {
+
+                snprintf(publishName, MAX_PATH_LENGTH, "%s", argv[++i]);
+            }
+            else if (0 == strcmp(argv[i], "-I") || 0 == strcmp(argv[i], "--publish-interval"))
+            {
+
+                publishInterval = atoi(argv[++i]);
+            }
+            else if (0 == strcmp(argv[i], "--record"))
+            {
+
+                snprintf(recordFile, MAX_PATH_LENGTH, "%s", argv[++i]);
+            }
+            else if (0 == strcmp(argv[i], "--replay"))
+            {
+
+                snprintf(replayFile, MAX_PATH_LENGTH, "%s", argv[++i]);
+            }
             else
             {
 
@@ -296,7 +420,51 @@ void checkParams()
         exit(EXIT_FAILURE);
     }
 
-    if (!useGui && tPoints == 0)
+    if (stepsPerSecond < 0)
+    {
+        printf("[ERROR] Number of time steps per second must not be negative!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (waterfallStride < 1)
+    {
+        printf("[ERROR] Waterfall stride must be at least 1!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (renderInterval < 0)
+    {
+        printf("[ERROR] Render interval must not be negative!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (publishInterval < 1)
+    {
+        printf("[ERROR] Publish interval must be at least 1!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (renderInterval > 0 && tPoints == 0)
+    {
+        printf("[ERROR] Rendering images of an endless loop is not allowed!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (recordFile[0] != '\0' && (!useGui || renderInterval > 0 || replayFile[0] != '\0'))
+    {
+        printf("[ERROR] Only sessions with visualisation can be recorded!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // the wave is only published by the simulation without window
+    if (publishName[0] != '\0' && (useGui || renderInterval > 0 || replayFile[0] != '\0'))
+    {
+        printf("[ERROR] The wave can only be published without visualisation, images or replay!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // a replay ends with the recorded session
+    if (!useGui && tPoints == 0 && replayFile[0] == '\0')
     {
         printf("[ERROR] Simulating an endless loop is only allowed with visualisation enabled!\n");
         exit(EXIT_FAILURE);
@@ -340,6 +508,15 @@ void getUserInputOrConfig(int numberofargc, char **argv)
     useGui = 1;
     printvalues = 0;
     doBenchmark = 0;
+    doTuning = 0;
+    stepsPerSecond = 0;
+    waterfallStride = DEFAULT_WATERFALL_STRIDE;
+    renderInterval = 0;
+    snprintf(renderOutput, MAX_PATH_LENGTH, "%s", DEFAULT_RENDER_OUTPUT);
+    publishName[0] = '\0';
+    publishInterval = DEFAULT_PUBLISH_INTERVAL;
+    recordFile[0] = '\0';
+    replayFile[0] = '\0';
 
     if (numberofargc > 1)
     {
@@ -354,6 +531,16 @@ void getUserInputOrConfig(int numberofargc, char **argv)
     }
 
     checkParams();
+
+    // untuned kernel: the whole line is one block, one time step per pass
+    kernelConfig.blockSize = nPoints;
+    kernelConfig.timeTile = 1;
+    kernelConfig.threads = 0;
+
+    if (!doTuning)
+    {
+        loadTuning();
+    }
 }
 
 double waveInitFunc(double x)
@@ -404,18 +591,421 @@ void simulateOneTimeStep(int holdflag)
     nextStep = tempStep;
 }
 
+void updateRange(double *older, const double *newer, int from, int to, int holdflag)
+{
+
+    int i;
+
+    for (i = from; i < to; i++)
+    {
+        older[i] = 2.0 * newer[i] - older[i] + cSquared * (newer[i - 1] - (2.0 * newer[i]) + newer[i + 1]);
+    }
+
+    if (holdflag >= from && holdflag < to)
+    {
+        // Point at holdflag is fixed, so just use the old position
+        older[holdflag] = newer[holdflag];
+    }
+}
+
+void simulateTiledTimeSteps(int steps, int holdflag)
+{
+
+    int t, s, j, depth, border, from, to;
+    double *tempStep;
+
+    // the boundaries keep their initial values until the first step,
+    // the in-place kernel expects them to be 0 in both arrays
+    if (steps > 0 && (currentStep[0] != 0.0 || currentStep[nPoints - 1] != 0.0))
+    {
+        simulateOneTimeStep(holdflag);
+        steps--;
+    }
+    previousStep[0] = 0.0;
+    previousStep[nPoints - 1] = 0.0;
+
+    // blocks have to be at least twice as wide as the time tile,
+    // otherwise the inverted trapezoids of neighbouring borders would overlap
+    int tile = kernelConfig.timeTile;
+    if (tile > (nPoints - 1) / 2)
+    {
+        tile = (nPoints - 1) / 2;
+    }
+    if (tile < 1)
+    {
+        tile = 1;
+    }
+
+    int numBlocks = (nPoints - 1) / (kernelConfig.blockSize > 2 * tile ? kernelConfig.blockSize : 2 * tile);
+    if (numBlocks < 1)
+    {
+        numBlocks = 1;
+    }
+
+    #pragma omp parallel private(t, s, j, depth, border, from, to, tempStep)
+    for (t = 0; t < steps; t += depth)
+    {
+        depth = (steps - t < tile) ? steps - t : tile;
+
+        // upright trapezoids, shrinking by one point per step on both sides
+        #pragma omp for schedule(static)
+        for (j = 0; j < numBlocks; j++)
+        {
+            for (s = 1; s <= depth; s++)
+            {
+                from = (int)((long)j * (nPoints - 1) / numBlocks) + s - 1;
+                to = (int)((long)(j + 1) * (nPoints - 1) / numBlocks) - s + 1;
+                from = (from < 1) ? 1 : from;
+                to = (to > nPoints - 1) ? nPoints - 1 : to;
+
+                // odd steps overwrite previousStep, even steps currentStep
+                if (s % 2)
+                {
+                    updateRange(previousStep, currentStep, from, to, holdflag);
+                }
+                else
+                {
+                    updateRange(currentStep, previousStep, from, to, holdflag);
+                }
+            }
+        }
+
+        // inverted trapezoids around every block border, including both ends of the line
+        #pragma omp for schedule(static)
+        for (j = 0; j <= numBlocks; j++)
+        {
+            border = (int)((long)j * (nPoints - 1) / numBlocks);
+
+            for (s = 2; s <= depth; s++)
+            {
+                from = (border - s + 1 < 1) ? 1 : border - s + 1;
+                to = (border + s - 1 > nPoints - 1) ? nPoints - 1 : border + s - 1;
+
+                if (s % 2)
+                {
+                    updateRange(previousStep, currentStep, from, to, holdflag);
+                }
+                else
+                {
+                    updateRange(currentStep, previousStep, from, to, holdflag);
+                }
+            }
+        }
+
+        // after an odd number of steps the newest values are in previousStep
+        #pragma omp single
+        if (depth % 2)
+        {
+            tempStep = previousStep;
+            previousStep = currentStep;
+            currentStep = tempStep;
+        }
+    }
+}
+
+void buildPyramid()
+{
+
+    int b, i, l, count, total, full, second;
+    double lo, hi;
+    const double *lower;
+    double *upper;
+
+    // the shape of the pyramid only depends on the number of points
+    if (pyramid == NULL)
+    {
+        count = (nPoints + LOD_BLOCK - 1) / LOD_BLOCK;
+        total = 0;
+
+        for (pyramidLevels = 0; pyramidLevels < LOD_MAX_LEVELS; pyramidLevels++)
+        {
+            pyramidOffsets[pyramidLevels] = total;
+            pyramidCounts[pyramidLevels] = count;
+            total += count;
+
+            if (count == 1)
+            {
+                pyramidLevels++;
+                break;
+            }
+            count = (count + 1) / 2;
+        }
+
+        pyramid = malloc(2 * total * sizeof(double));
+
+        if (pyramid == NULL)
+        {
+            printf("[ERROR] Could not allocate the level of detail pyramid!\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // level 0 holds the minimum and maximum of every block of points
+    full = nPoints / LOD_BLOCK;
+
+    // the blocks are independent, every thread takes a part of the line
+    #pragma omp parallel for schedule(static) private(b, i, lo, hi) shared(currentStep, pyramid, full)
+    for (b = 0; b < full; b++)
+    {
+        lo = currentStep[b * LOD_BLOCK];
+        hi = currentStep[b * LOD_BLOCK];
+
+        // the compiler turns this into vector min/max instructions
+        #pragma omp simd reduction(min : lo) reduction(max : hi)
+        for (i = b * LOD_BLOCK + 1; i < (b + 1) * LOD_BLOCK; i++)
+        {
+            lo = (currentStep[i] < lo) ? currentStep[i] : lo;
+            hi = (currentStep[i] > hi) ? currentStep[i] : hi;
+        }
+
+        pyramid[2 * b] = lo;
+        pyramid[2 * b + 1] = hi;
+    }
+
+    // the last block may be shorter
+    if (full < pyramidCounts[0])
+    {
+        lo = currentStep[full * LOD_BLOCK];
+        hi = currentStep[full * LOD_BLOCK];
+
+        for (i = full * LOD_BLOCK + 1; i < nPoints; i++)
+        {
+            lo = (currentStep[i] < lo) ? currentStep[i] : lo;
+            hi = (currentStep[i] > hi) ? currentStep[i] : hi;
+        }
+
+        pyramid[2 * full] = lo;
+        pyramid[2 * full + 1] = hi;
+    }
+
+    // every entry of the next level combines two neighbors of the level below
+    for (l = 1; l < pyramidLevels; l++)
+    {
+        lower = &pyramid[2 * pyramidOffsets[l - 1]];
+        upper = &pyramid[2 * pyramidOffsets[l]];
+
+        for (b = 0; b < pyramidCounts[l]; b++)
+        {
+            // an odd last entry has no neighbor
+            second = (2 * b + 1 < pyramidCounts[l - 1]) ? 2 * b + 1 : 2 * b;
+
+            upper[2 * b] = (lower[4 * b] < lower[2 * second]) ? lower[4 * b] : lower[2 * second];
+            upper[2 * b + 1] = (lower[4 * b + 1] > lower[2 * second + 1]) ? lower[4 * b + 1] : lower[2 * second + 1];
+        }
+    }
+}
+
+void rangeMinMax(int from, int to, double *minimum, double *maximum)
+{
+
+    int l, b0, b1;
+    double lo, hi;
+    const double *level;
+
+    lo = currentStep[from];
+    hi = currentStep[from];
+
+    // single points before the first and after the last whole block
+    while (from < to && from % LOD_BLOCK != 0)
+    {
+        lo = (currentStep[from] < lo) ? currentStep[from] : lo;
+        hi = (currentStep[from] > hi) ? currentStep[from] : hi;
+        from++;
+    }
+
+    while (to > from && to % LOD_BLOCK != 0)
+    {
+        to--;
+        lo = (currentStep[to] < lo) ? currentStep[to] : lo;
+        hi = (currentStep[to] > hi) ? currentStep[to] : hi;
+    }
+
+    // the whole blocks in between, taking an odd entry at either end
+    // and moving up a level, so at most two entries per level are read
+    b0 = from / LOD_BLOCK;
+    b1 = to / LOD_BLOCK;
+
+    for (l = 0; b0 < b1; l++)
+    {
+        level = &pyramid[2 * pyramidOffsets[l]];
+
+        if (b0 % 2)
+        {
+            lo = (level[2 * b0] < lo) ? level[2 * b0] : lo;
+            hi = (level[2 * b0 + 1] > hi) ? level[2 * b0 + 1] : hi;
+            b0++;
+        }
+
+        if (b1 % 2)
+        {
+            b1--;
+            lo = (level[2 * b1] < lo) ? level[2 * b1] : lo;
+            hi = (level[2 * b1 + 1] > hi) ? level[2 * b1 + 1] : hi;
+        }
+
+        b0 /= 2;
+        b1 /= 2;
+    }
+
+    *minimum = lo;
+    *maximum = hi;
+}
+
+void decimateWave(int from, int to, int columns, double *minMax)
+{
+
+    int c;
+
+    // the columns are independent, every thread takes a part of the view
+    #pragma omp parallel for schedule(static) private(c) shared(from, to, columns, minMax)
+    for (c = 0; c < columns; c++)
+    {
+        rangeMinMax(from + (int)((long)c * (to - from) / columns),
+                    from + (int)((long)(c + 1) * (to - from) / columns),
+                    &minMax[2 * c], &minMax[2 * c + 1]);
+    }
+}
+
+double computeEnergy()
+{
+
+    double kinetic = 0.0, potential = 0.0;
+    int i;
+
+    #pragma omp parallel for schedule(static) private(i) shared(currentStep, previousStep) reduction(+ : kinetic, potential)
+    for (i = 0; i < nPoints - 1; i++)
+    {
+        kinetic += (currentStep[i] - previousStep[i]) * (currentStep[i] - previousStep[i]);
+        potential += (currentStep[i + 1] - currentStep[i]) * (currentStep[i + 1] - currentStep[i]);
+    }
+
+    return 0.5 * (kinetic + cSquared * potential);
+}
+
+void openSharedWave()
+{
+
+    char path[MAX_PATH_LENGTH + 1];
+    int fd;
+
+    if (publishName[0] == '\0')
+    {
+        return;
+    }
+
+    // POSIX shared memory names start with a slash
+    snprintf(path, sizeof(path), "%s%s", (publishName[0] == '/') ? "" : "/", publishName);
+
+    fd = shm_open(path, O_CREAT | O_RDWR, 0644);
+    if (fd < 0 || ftruncate(fd, sizeof(SharedWave)) != 0)
+    {
+        printf("[ERROR] Could not create shared memory '%s'!\n", path);
+        exit(EXIT_FAILURE);
+    }
+
+    sharedWave = mmap(NULL, sizeof(SharedWave), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (sharedWave == MAP_FAILED)
+    {
+        printf("[ERROR] Could not map shared memory '%s'!\n", path);
+        exit(EXIT_FAILURE);
+    }
+
+    // an old run may have left frames, they must not look new
+    sharedWave->latest = -1;
+    sharedWave->finished = 0;
+    sharedWave->slots = SHARED_SLOTS;
+    sharedWave->maxColumns = SHARED_COLUMNS;
+    sharedWave->npoints = nPoints;
+
+    // the magic comes last, viewers wait for it
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(sharedWave->magic, SHARED_MAGIC, sizeof(sharedWave->magic));
+
+    printf("Publishing every %d time steps to shared memory '%s'\n", publishInterval, path);
+}
+
+void publishSharedWave(int step)
+{
+
+    int slot;
+    uint32_t sequence;
+    SharedFrame *frame;
+
+    if (sharedWave == NULL)
+    {
+        return;
+    }
+
+    slot = (sharedWave->latest + 1) % SHARED_SLOTS;
+    frame = &sharedWave->frames[slot];
+    sequence = frame->sequence;
+
+    // odd while the frame is written
+    __atomic_store_n(&frame->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    frame->step = step;
+    frame->columns = (nPoints < SHARED_COLUMNS) ? nPoints : SHARED_COLUMNS;
+
+    buildPyramid();
+    decimateWave(0, nPoints, frame->columns, frame->values);
+
+    __atomic_store_n(&frame->sequence, sequence + 2, __ATOMIC_RELEASE);
+    __atomic_store_n(&sharedWave->latest, slot, __ATOMIC_RELEASE);
+}
+
+void closeSharedWave()
+{
+
+    char path[MAX_PATH_LENGTH + 1];
+
+    if (sharedWave == NULL)
+    {
+        return;
+    }
+
+    __atomic_store_n(&sharedWave->finished, 1, __ATOMIC_RELEASE);
+    munmap(sharedWave, sizeof(SharedWave));
+    sharedWave = NULL;
+
+    snprintf(path, sizeof(path), "%s%s", (publishName[0] == '/') ? "" : "/", publishName);
+    shm_unlink(path);
+}
+
 double simulateNumberOfTimeSteps()
 {
 
+    int step, steps;
+
+    openSharedWave();
+
     double start = omp_get_wtime();
 
-    for (int i = 1; i < tPoints; ++i)
+    if (sharedWave == NULL)
     {
-        simulateOneTimeStep(0);
+        simulateTiledTimeSteps(tPoints - 1, 0);
+    }
+    else
+    {
+
+        // the viewers get a frame every publishInterval steps
+        publishSharedWave(1);
+
+        for (step = 1; step < tPoints; step += steps)
+        {
+            steps = (publishInterval < tPoints - step) ? publishInterval : tPoints - step;
+
+            simulateTiledTimeSteps(steps, 0);
+            publishSharedWave(step + steps);
+        }
     }
 
     double end = omp_get_wtime();
 
+    closeSharedWave();
+
     if (printvalues)
     {
         outputNew();
@@ -430,6 +1020,8 @@ void finalizeWave()
     free(previousStep);
     free(currentStep);
     free(nextStep);
+    free(pyramid);
+    pyramid = NULL;
 }
 
 void resetWave()
@@ -511,6 +1103,253 @@ void performBenchmark()
     fclose(fp);
 }
 
+void getCpuModel(char *model, int len)
+{
+    const int MAXLINE = 200;
+
+    FILE *filePointer;
+    char buffer[MAXLINE];
+    char *value;
+
+    snprintf(model, len, "unknown");
+
+    filePointer = fopen("/proc/cpuinfo", "r");
+    if (NULL == filePointer)
+    {
+        return;
+    }
+
+    // the line looks like "model name\t: <model>"
+    while (NULL != fgets(buffer, MAXLINE, filePointer))
+    {
+        value = strchr(buffer, ':');
+
+        if (0 == strncmp(buffer, "model name", 10) && NULL != value)
+        {
+            value += strspn(value, ": \t");
+            value[strcspn(value, "\n")] = '\0';
+            snprintf(model, len, "%s", value);
+            break;
+        }
+    }
+
+    fclose(filePointer);
+}
+
+void loadTuning()
+{
+    const int MAXLINE = 200;
+
+    FILE *filePointer;
+    char buffer[MAXLINE], cpuModel[MAXLINE], entryKernel[MAXLINE], entryModel[MAXLINE];
+    int entryPoints, tunedPoints = 0;
+    double distance, bestDistance = -1.0;
+    KernelConfig entry;
+
+    // without a tuning database the default configuration is used
+    filePointer = fopen(TUNING_FILE_PATH, "r");
+    if (NULL == filePointer)
+    {
+        return;
+    }
+
+    getCpuModel(cpuModel, MAXLINE);
+
+    while (NULL != fgets(buffer, MAXLINE, filePointer))
+    {
+
+        // ignore comments or empty lines
+        if ('#' == buffer[0] || '\n' == buffer[0])
+        {
+            continue;
+        }
+
+        if (6 != sscanf(buffer, "%s %d %d %d %d %[^\n]", entryKernel, &entryPoints, &entry.blockSize, &entry.timeTile, &entry.threads, entryModel) ||
+            entryPoints <= 0 || entry.blockSize <= 0 || entry.timeTile < 1 || entry.timeTile > MAX_TIME_TILE || entry.threads < 0)
+        {
+            buffer[strcspn(buffer, "\n")] = '\0';
+            printf("[INFO] Ignoring invalid tuning entry: '%s'\n", buffer);
+            continue;
+        }
+
+        // only entries for this kernel on this cpu are relevant
+        if (0 != strcmp(entryKernel, TUNING_KERNEL_NAME) || 0 != strcmp(entryModel, cpuModel))
+        {
+            continue;
+        }
+
+        // prefer the entry tuned for the most similar number of points
+        distance = fabs(log((double)entryPoints / nPoints));
+        if (bestDistance < 0 || distance < bestDistance)
+        {
+            bestDistance = distance;
+            tunedPoints = entryPoints;
+            kernelConfig = entry;
+        }
+    }
+
+    fclose(filePointer);
+
+    if (bestDistance >= 0)
+    {
+        // an explicitly set OMP_NUM_THREADS (e.g. by benchStart.sh) wins over the tuned value
+        if (kernelConfig.threads > 0 && NULL == getenv("OMP_NUM_THREADS"))
+        {
+            omp_set_num_threads(kernelConfig.threads);
+        }
+
+        printf("Using kernel tuned for %d points: block size %d, time tile %d, %d threads\n", tunedPoints, kernelConfig.blockSize, kernelConfig.timeTile, omp_get_max_threads());
+    }
+}
+
+void saveTuning(KernelConfig config)
+{
+    const int MAXLINE = 200;
+
+    FILE *oldFile, *newFile;
+    char buffer[MAXLINE], cpuModel[MAXLINE], entryKernel[MAXLINE], entryModel[MAXLINE];
+    int entryPoints;
+
+    getCpuModel(cpuModel, MAXLINE);
+
+    // write to a temporary file first, so an aborted run can't destroy the database
+    newFile = fopen(TUNING_FILE_PATH ".tmp", "w");
+    if (NULL == newFile)
+    {
+        printf("[ERROR] Could not get file '%s'!\n", TUNING_FILE_PATH ".tmp");
+        exit(EXIT_FAILURE);
+    }
+
+    oldFile = fopen(TUNING_FILE_PATH, "r");
+    if (NULL == oldFile)
+    {
+        fprintf(newFile, "# Kernel tuning database\n#\n");
+        fprintf(newFile, "# This file is written by the tuning mode of the wave programs (-T POINTS)\n");
+        fprintf(newFile, "# and read on every start. The format is:\n");
+        fprintf(newFile, "# KERNEL POINTS BLOCK_SIZE TIME_TILE THREADS CPU_MODEL\n");
+    }
+    else
+    {
+
+        // copy all entries except the one getting replaced
+        while (NULL != fgets(buffer, MAXLINE, oldFile))
+        {
+            if ('#' != buffer[0] && 3 == sscanf(buffer, "%s %d %*d %*d %*d %[^\n]", entryKernel, &entryPoints, entryModel) &&
+                0 == strcmp(entryKernel, TUNING_KERNEL_NAME) && entryPoints == nPoints && 0 == strcmp(entryModel, cpuModel))
+            {
+                continue;
+            }
+
+            fputs(buffer, newFile);
+            if (NULL == strchr(buffer, '\n'))
+            {
+                fputc('\n', newFile);
+            }
+        }
+
+        fclose(oldFile);
+    }
+
+    fprintf(newFile, "%s %d %d %d %d %s\n", TUNING_KERNEL_NAME, nPoints, config.blockSize, config.timeTile, config.threads, cpuModel);
+    fclose(newFile);
+
+    if (0 != rename(TUNING_FILE_PATH ".tmp", TUNING_FILE_PATH))
+    {
+        printf("[ERROR] Could not write file '%s'!\n", TUNING_FILE_PATH);
+        exit(EXIT_FAILURE);
+    }
+}
+
+void performTuning()
+{
+    const int RERUNS = 3;
+    const int blockSizes[] = {512, 2048, 8192, 32768, 131072, MAX_POINTS};
+    const int timeTiles[] = {1, 2, 4, 8, 16, 32};
+    const int numBlockSizes = sizeof(blockSizes) / sizeof(blockSizes[0]);
+    const int numTimeTiles = sizeof(timeTiles) / sizeof(timeTiles[0]);
+    const int maxThreads = omp_get_num_procs();
+
+    KernelConfig best = kernelConfig;
+    double bestTime = -1.0, runtime, start;
+    int b, t, r, threads;
+
+    // about 5*10^7 point updates per run, enough to get stable timings
+    int steps = 50000000 / nPoints;
+    if (steps < 2 * MAX_TIME_TILE)
+    {
+        steps = 2 * MAX_TIME_TILE;
+    }
+
+    initWaveConditions();
+
+    printf("Tuning for %d points with %d time steps per run...\n", nPoints, steps);
+
+    // try powers of two up to the number of processors, then the number of processors itself
+    for (threads = 1; threads <= maxThreads; threads = (threads < maxThreads && 2 * threads > maxThreads) ? maxThreads : 2 * threads)
+    {
+        omp_set_num_threads(threads);
+
+        for (b = 0; b < numBlockSizes; b++)
+        {
+
+            // all bigger block sizes would be the whole line again
+            if (b > 0 && blockSizes[b - 1] >= nPoints)
+            {
+                break;
+            }
+
+            for (t = 0; t < numTimeTiles; t++)
+            {
+                kernelConfig.blockSize = (blockSizes[b] < nPoints) ? blockSizes[b] : nPoints;
+                kernelConfig.timeTile = timeTiles[t];
+                kernelConfig.threads = threads;
+
+                // the kernel would shrink the tile anyway
+                if (t > 0 && 2 * kernelConfig.timeTile > kernelConfig.blockSize)
+                {
+                    break;
+                }
+
+                // use the fastest of some reruns
+                runtime = -1.0;
+                for (r = 0; r < RERUNS; r++)
+                {
+                    resetWave();
+
+                    start = omp_get_wtime();
+                    simulateTiledTimeSteps(steps, 0);
+                    start = omp_get_wtime() - start;
+
+                    if (runtime < 0 || start < runtime)
+                    {
+                        runtime = start;
+                    }
+                }
+
+                printf("Block size %8d, time tile %2d, %2d threads: %8.4f ns per point and step\n", kernelConfig.blockSize, kernelConfig.timeTile, threads, 1E9 * runtime / ((double)steps * nPoints));
+
+                if (bestTime < 0 || runtime < bestTime)
+                {
+                    bestTime = runtime;
+                    best = kernelConfig;
+                }
+            }
+        }
+
+        if (threads == maxThreads)
+        {
+            break;
+        }
+    }
+
+    finalizeWave();
+
+    printf("Fastest: block size %d, time tile %d, %d threads (%8.4f ns per point and step)\n", best.blockSize, best.timeTile, best.threads, 1E9 * bestTime / ((double)steps * nPoints));
+
+    saveTuning(best);
+    printf("Saved to '%s'\n", TUNING_FILE_PATH);
+}
+
 double *getStep()
 {
     return currentStep;
@@ -540,3 +1379,48 @@ int doBench()
 {
     return doBenchmark;
 }
+
+int doTune()
+{
+    return doTuning;
+}
+
+int getStepsPerSecond()
+{
+    return stepsPerSecond;
+}
+
+int getWaterfallStride()
+{
+    return waterfallStride;
+}
+
+int getRenderInterval()
+{
+    return renderInterval;
+}
+
+const char *getRenderOutput()
+{
+    return renderOutput;
+}
+
+const char *getPublishName()
+{
+    return publishName;
+}
+
+int doPrintValues()
+{
+    return printvalues;
+}
+
+const char *getRecordFile()
+{
+    return recordFile;
+}
+
+const char *getReplayFile()
+{
+    return replayFile;
+}
@@ -14,6 +14,10 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 /**
  * @def _USE_MATH_DEFINES
@@ -51,6 +55,141 @@
  */
 #define BENCHMARK_FILE "../benchmark/benchResults.txt"
 
+/**
+ * @def MAX_PATH_LENGTH
+ * 
+ * Represents the maximum length of a file path
+ */
+#define MAX_PATH_LENGTH 256
+
+/**
+ * @def DEFAULT_RENDER_OUTPUT
+ * 
+ * The default file name prefix of the rendered images
+ */
+#define DEFAULT_RENDER_OUTPUT "frame"
+
+/**
+ * @def RAW_RENDER_SUFFIX
+ * 
+ * Rendered images go into a single raw RGB stream if the output ends with this
+ */
+#define RAW_RENDER_SUFFIX ".rgb"
+
+/**
+ * @def SHARED_SLOTS
+ * 
+ * Represents the number of frames in the shared memory ring for external viewers
+ */
+#define SHARED_SLOTS 4
+
+/**
+ * @def SHARED_COLUMNS
+ * 
+ * Represents the maximum number of columns of a frame in shared memory
+ */
+#define SHARED_COLUMNS 4096
+
+/**
+ * @def SHARED_MAGIC
+ * 
+ * The first 8 bytes of the shared memory, checked by the viewers
+ */
+#define SHARED_MAGIC "WAVESHM1"
+
+/**
+ * @def DEFAULT_PUBLISH_INTERVAL
+ * 
+ * The default number of time steps between two frames in shared memory
+ */
+#define DEFAULT_PUBLISH_INTERVAL 10
+
+/**
+ * @def DEFAULT_WATERFALL_STRIDE
+ * 
+ * The default number of time steps between two rows of the waterfall view
+ */
+#define DEFAULT_WATERFALL_STRIDE 1
+
+/**
+ * @def TUNING_FILE_PATH
+ * 
+ * The tuning database written by the tuning mode and read on every start
+ */
+#define TUNING_FILE_PATH "../tuning.txt"
+
+/**
+ * @def TUNING_KERNEL_NAME
+ * 
+ * The key of this program's kernel in the tuning database
+ */
+#define TUNING_KERNEL_NAME "MP"
+
+/**
+ * @def MAX_TIME_TILE
+ * 
+ * Represents the maximum number of time steps computed per tile
+ */
+#define MAX_TIME_TILE 64
+
+/**
+ * @def LOD_BLOCK
+ * 
+ * Represents the number of points per entry in the lowest level of the level of detail pyramid
+ */
+#define LOD_BLOCK 8
+
+/**
+ * @def LOD_MAX_LEVELS
+ * 
+ * Represents the maximum number of levels of the level of detail pyramid
+ */
+#define LOD_MAX_LEVELS 32
+
+/**
+ * @brief The tunable parameters of the tiled wave kernel
+ */
+typedef struct
+{
+    int blockSize; /**< number of points per spatial block */
+    int timeTile;  /**< number of time steps computed per pass over a block */
+    int threads;   /**< number of threads, 0 keeps the default */
+} KernelConfig;
+
+/**
+ * @brief A frame in shared memory, guarded by a sequence lock
+ *
+ * The sequence is odd while the simulation writes the frame. A viewer copies the frame
+ * and only keeps the copy if the sequence was even and did not change meanwhile.
+ * All fields have a fixed size, so viewers in other languages can read the layout.
+ */
+typedef struct
+{
+    uint32_t sequence;               /**< increased before and after every write */
+    int32_t step;                    /**< time step of the values */
+    int32_t columns;                 /**< number of columns */
+    int32_t reserved;                /**< keeps the values 8 byte aligned */
+    double values[2 * SHARED_COLUMNS]; /**< minimum and maximum of every column, interleaved */
+} SharedFrame;
+
+/**
+ * @brief The shared memory for external viewers, a ring of frames
+ *
+ * The simulation always writes the slot after @c latest, so a viewer reading the
+ * newest frame is only disturbed if it takes longer than @c SHARED_SLOTS - 1 frames.
+ */
+typedef struct
+{
+    char magic[8];                   /**< @c SHARED_MAGIC without the terminating 0 */
+    int32_t slots;                   /**< @c SHARED_SLOTS */
+    int32_t maxColumns;              /**< @c SHARED_COLUMNS */
+    int32_t npoints;                 /**< number of points on the line */
+    int32_t latest;                  /**< slot of the newest complete frame, -1 before the first one */
+    int32_t finished;                /**< set after the last frame */
+    int32_t reserved;                /**< keeps the frames 8 byte aligned */
+    SharedFrame frames[SHARED_SLOTS]; /**< the ring of frames */
+} SharedWave;
+
 
 /**
   * @brief Calculates the initial sine wave values 
@@ -105,6 +244,103 @@ void initWaveConditions(void);
   */
 void simulateOneTimeStep(int holdflag);
 
+/**
+  * @brief Calculates one time step for the points in [@c from, @c to)
+  * 
+  * The new values overwrite the values two steps in the past, which are
+  * only needed at the same index.
+  * 
+  * @param older Array holding the time step before @c newer, gets overwritten
+  * @param newer Array holding the latest time step
+  * @param from First index to calculate
+  * @param to Index after the last one to calculate
+  * @param holdflag If not 0, indicates that the point at this x coordinate should be fixed ("hold")
+  */
+void updateRange(double *older, const double *newer, int from, int to, int holdflag);
+
+/**
+  * @brief Simulates a number of time steps with the tiled kernel
+  * 
+  * The line is split into blocks of @c blockSize points. Every block first
+  * calculates @c timeTile steps on a shrinking trapezoid, afterwards the
+  * remaining inverted trapezoids around the block borders are filled in.
+  * The results are identical to calling @c simulateOneTimeStep() @c steps times.
+  * 
+  * @param steps The number of time steps
+  * @param holdflag If not 0, indicates that the point at this x coordinate should be fixed ("hold")
+  */
+void simulateTiledTimeSteps(int steps, int holdflag);
+
+/**
+  * @brief Builds the minimum and maximum pyramid of the current values
+  * 
+  * Level 0 holds the minimum and maximum of every block of LOD_BLOCK points,
+  * every higher level combines two neighbors of the level below.
+  * The pyramid is allocated with the first call and freed in finalizeWave().
+  */
+void buildPyramid(void);
+
+/**
+  * @brief Returns the minimum and maximum of the current values in a range
+  * 
+  * Reads the pyramid from the last buildPyramid() call for the whole blocks
+  * and the values for the rest, so it takes O(LOD_BLOCK + log(points)).
+  * 
+  * @param from First index of the range
+  * @param to Index after the last one of the range, greater than @c from
+  * @param minimum Pointer for the minimum
+  * @param maximum Pointer for the maximum
+  */
+void rangeMinMax(int from, int to, double *minimum, double *maximum);
+
+/**
+  * @brief Reduces the current values to the minimum and maximum of every column
+  * 
+  * The points in [@c from, @c to) are split evenly into the columns, so the wave
+  * can be drawn with at most two vertices per column whatever the number of points.
+  * Every column is a rangeMinMax() query, so buildPyramid() must be called after
+  * the values changed.
+  * 
+  * @param from First index of the range
+  * @param to Index after the last one of the range, at least @c columns after @c from
+  * @param columns The number of columns
+  * @param minMax Array for the minimum and maximum of every column, interleaved
+  */
+void decimateWave(int from, int to, int columns, double *minMax);
+
+/**
+  * @brief Returns the discrete energy of the current time step
+  *
+  * The kinetic part comes from the change since the previous step, the potential part
+  * from the difference between neighbors. Without damping it stays about constant.
+  *
+  * @return The energy in the units of the grid
+  */
+double computeEnergy(void);
+
+/**
+  * @brief Creates the shared memory for external viewers, if a name was set
+  *
+  * Exits the program if the shared memory cannot be created.
+  */
+void openSharedWave(void);
+
+/**
+  * @brief Writes the current values into the next frame of the shared memory
+  *
+  * Does nothing if there is no shared memory.
+  *
+  * @param step the time step of the values
+  */
+void publishSharedWave(int step);
+
+/**
+  * @brief Marks the shared memory as finished and removes its name
+  *
+  * Viewers that are still attached can read the last frame until they detach.
+  */
+void closeSharedWave(void);
+
 /**
   * @brief Simulates a number of time steps
   * 
@@ -132,6 +368,36 @@ void outputNew(void);
   */
 void performBenchmark(void);
 
+/**
+  * @brief Reads the model name of the CPU
+  *
+  * @param model Buffer for the model name
+  * @param len Size of the buffer
+  */
+void getCpuModel(char *model, int len);
+
+/**
+  * @brief Loads the best kernel configuration for this CPU from the tuning database
+  * 
+  * The entry whose number of points is closest to the current one is used.
+  * Without a matching entry the default configuration stays active.
+  */
+void loadTuning(void);
+
+/**
+  * @brief Writes a kernel configuration for this CPU to the tuning database
+  * 
+  * An existing entry for the same CPU and number of points gets replaced.
+  *
+  * @param config The configuration to save
+  */
+void saveTuning(KernelConfig config);
+
+/**
+  * @brief Searches the fastest kernel configuration for the current number of points
+  */
+void performTuning(void);
+
 /**
   * @brief Returns the current state of the wave values
   *
@@ -174,4 +440,67 @@ int showGui(void);
   */
 int doBench(void);
 
+/**
+  * @brief Returns the current state of the tuning flag
+  *
+  * @return Whether to tune the kernel or not
+  */
+int doTune(void);
+
+/**
+  * @brief Returns the number of time steps per second in the visualisation
+  *
+  * @return The time steps per second, 0 for as fast as possible
+  */
+int getStepsPerSecond(void);
+
+/**
+  * @brief Returns the number of time steps between two rows of the waterfall view
+  *
+  * @return The time steps per row, at least 1
+  */
+int getWaterfallStride(void);
+
+/**
+  * @brief Returns the number of time steps between two images without window
+  *
+  * @return The time steps between two images, 0 if no images are rendered
+  */
+int getRenderInterval(void);
+
+/**
+  * @brief Returns the file name prefix of the rendered images
+  *
+  * @return The prefix, or the file of the raw RGB stream if it ends with @c RAW_RENDER_SUFFIX
+  */
+const char *getRenderOutput(void);
+
+/**
+  * @brief Returns the name of the shared memory for external viewers
+  *
+  * @return The name, empty if no frames are published
+  */
+const char *getPublishName(void);
+
+/**
+  * @brief Returns whether the final values are printed
+  *
+  * @return 1 if they are printed, 0 otherwise
+  */
+int doPrintValues(void);
+
+/**
+  * @brief Returns the file the session of the visualisation is recorded to
+  *
+  * @return The file name, empty if the session is not recorded
+  */
+const char *getRecordFile(void);
+
+/**
+  * @brief Returns the file of a recorded session to replay without window
+  *
+  * @return The file name, empty if no session is replayed
+  */
+const char *getReplayFile(void);
+
 #endif //__CORE_MP_H_
@@ -13,7 +13,13 @@
 double *previousStep, *currentStep, *nextStep, *globalStep;
 
 // setting values
-int intervalEnd, nPointsGlobal, nPointsLocal, tPoints, periods, amplitude, useGui, printvalues, doBenchmark;
+int intervalEnd, nPointsGlobal, nPointsLocal, tPoints, periods, amplitude, useGui, printvalues, doBenchmark, threadsPerRank, ghostDepth, streamChunk, snapshotInterval, haloMode, useSharedMemory, rebalanceInterval, checkpointInterval;
+
+// binary file for the collective output, empty if disabled
+char outputFile[MAX_PATH_LENGTH];
+
+// checkpoint file written every checkpointInterval steps and the file to restart from, empty if disabled
+char checkpointFile[MAX_PATH_LENGTH], restartFile[MAX_PATH_LENGTH];
 
 const double DELTA_T = 1.0;
 double deltaX, lambda, c, cSquared, waveSpeed;
@@ -21,22 +27,84 @@ double deltaX, lambda, c, cSquared, waveSpeed;
 // MPI related values
 int id, numberOfProcesses;
 
+// the processes form a line, the ends have MPI_PROC_NULL as neighbor
+MPI_Comm waveComm;
+int leftNeighbor, rightNeighbor;
+
 // border values
 int left, right;
 
+// number of ghost points on each side (0 at the ends of the line)
+int ghostsLeft, ghostsRight;
+
+// steps done since the last halo exchange
+int stepInBlock;
+
+// buffers for the halo exchange
+double *sendLeft, *recvLeft, *sendRight, *recvRight;
+int haloSize;
+
+// requests for the halo exchange (recieve and send for left and right), set up once with HALO_PERSISTENT
+MPI_Request haloRequests[4];
+
+// window over both recieve buffers and the group of the neighbors for HALO_RMA
+MPI_Win haloWindow;
+MPI_Group neighborGroup;
+
+// all processes on one node share the time step arrays, the ghost points are the neighbors' points
+int sharedMemoryActive;
+MPI_Comm nodeComm;
+MPI_Win stepWindows[3];
+
+// number of points owned by this process (without ghost points)
+int ownedPoints;
+
+// owned points and their start index in the global array for every process
+int *recvCounts, *displacements;
+
+// time steps since the last reset and the last rebalancing, and the time spent calculating since then
+int stepsDone, stepsSinceRebalance;
+double computeTime;
+
+// time spent in each phase on this process, summed over all runs
+double phaseTimes[NUMBER_OF_PHASES];
+const char *phaseNames[NUMBER_OF_PHASES] = {"compute", "halo", "wait", "rebalance", "collect", "io"};
+
+// decimated frame for the visualisation: the own min/max pairs, all pairs on the master and the merged frame
+double *frameBuffer, *frameGathered, *frame;
+int frameCapacity, gatheredCapacity, frameColumns;
+int *frameCounts, *frameDisplacements, *frameFirstColumns;
+MPI_Request frameRequest = MPI_REQUEST_NULL;
+
+// energy of the own points and the sum of all processes on the master, reduced together with the frame
+double localEnergy, frameEnergy;
+MPI_Request energyRequest = MPI_REQUEST_NULL;
+
+// master buffer for one chunk in streaming mode
+double *streamBuffer;
+
+// shared output file and number of frames written to it
+MPI_File outputHandle;
+int framesWritten;
+
+// checkpoint being written in the background, its step is -1 if there is none
+MPI_File checkpointHandle;
+MPI_Request checkpointRequests[2];
+double *checkpointBuffer;
+int checkpointStep;
+
+// step the simulation continues from after a restart
+int restartStep;
+
 const int FIRST = 0;
 int LAST;
 
-MPI_Status status;
-
 // MPI message tags for sending/recieving
 const int L_TO_R = 10;
 const int R_TO_L = 20;
-const int INFO = 30;
 const int ACTUAL = 40;
-
-// buffer for sending data info
-int buffer[2];
+const int MIGRATE_PREVIOUS = 50;
+const int MIGRATE_CURRENT = 60;
 
 void CHECK(int ierr)
 {
@@ -70,9 +138,21 @@ void outputHelpMessage()
     printf("\tAMPLITUDE\t\tThe amplitude of the sine wave\t\t\t\t\tLINE_INTERVAL_END / 4\n");
     printf("\tLAMBDA\t\t\tThe damping factor for the sine wave\t\t\t\t0 (no damping)\n");
     printf("\tSHOW_GUI\t\tShow the visualisation of the wave\t\t\t\t1 (true)\n");
-    printf("\tPRINT_VALUES\t\tPrint final values to console\t\t\t\t\t0 (false)\n\n");
-    printf("From cmd line: 'mpiexec myWaveMPI [-s SPEED] [-t TIMESTEPS] [-i INTERVALEND] [-n POINTS] [-p PERIODS] [-a AMPLITUDE] [-l LAMBDA] [-u SHOWGUI] [-v PRINTVALUES]'\n\n");
-    printf("To perform benchmarks, use 'mpiexec myWaveMPI -b TIMESTEPS POINTS' or 'mpiexec myWaveMPI --benchmark TIMESTEPS POINTS'\n");
+    printf("\tPRINT_VALUES\t\tPrint final values to console\t\t\t\t\t0 (false)\n");
+    printf("\tTHREADS_PER_RANK\tNumber of OpenMP threads per process\t\t\t\t0 (OMP_NUM_THREADS or 1)\n");
+    printf("\tGHOST_DEPTH\t\tSteps between two halo exchanges (ghost points per side)\t1\n");
+    printf("\tHALO_MODE\t\tHalo exchange: %d = MPI_Isend/MPI_Irecv, %d = persistent requests, %d = MPI_Put\t%d\n", HALO_MESSAGES, HALO_PERSISTENT, HALO_RMA, HALO_MESSAGES);
+    printf("\tSHARED_MEMORY\t\tShare the wave between processes if all run on one node\t\t0 (false)\n");
+    printf("\tREBALANCE_INTERVAL\tMove points from slow to fast processes every this many steps\t0 (off)\n");
+    printf("\tSTREAM_CHUNK\t\tStream values to master in chunks of this size (no GUI)\t\t0 (off)\n");
+    printf("\tOUTPUT_FILE\t\tBinary file for the wave values, written by all processes (no GUI)\t- (off)\n");
+    printf("\tSNAPSHOT_INTERVAL\tAlso write the wave to OUTPUT_FILE every this many time steps\t0 (final only)\n");
+    printf("\tCHECKPOINT_INTERVAL\tWrite a checkpoint every this many time steps (no GUI)\t\t0 (off)\n");
+    printf("\tCHECKPOINT_FILE\t\tFile for the checkpoints\t\t\t\t\t\t%s\n", DEFAULT_CHECKPOINT_FILE);
+    printf("\tRESTART_FILE\t\tCheckpoint to continue from, with any number of processes\t- (off)\n\n");
+    printf("From cmd line: 'mpiexec myWaveMPI [-s SPEED] [-t TIMESTEPS] [-i INTERVALEND] [-n POINTS] [-p PERIODS] [-a AMPLITUDE] [-l LAMBDA] [-u SHOWGUI] [-v PRINTVALUES] [-r THREADS_PER_RANK] [-g GHOST_DEPTH] [-m HALO_MODE] [-w SHARED_MEMORY] [-d REBALANCE_INTERVAL] [-k STREAM_CHUNK] [-o OUTPUT_FILE] [-e SNAPSHOT_INTERVAL] [-q CHECKPOINT_INTERVAL] [-f CHECKPOINT_FILE] [-R RESTART_FILE]'\n\n");
+    printf("For hybrid runs, start one process per socket, e.g. 'mpiexec --map-by ppr:2:node:pe=8 myWaveMPI -r 8'\n");
+    printf("To perform benchmarks, use 'mpiexec myWaveMPI -b TIMESTEPS POINTS [OPTIONS]' or 'mpiexec myWaveMPI --benchmark TIMESTEPS POINTS [OPTIONS]'\n");
     printf("To show this message, use 'mpiexec myWaveMPI -h' or 'mpiexec myWaveMPI --help'\n");
 }
 
@@ -90,12 +170,8 @@ void getFromSettingsFile(char *configPath)
 
     if (NULL == filePointer)
     {
-        if (id == FIRST)
-        {
-            printf("[ERROR] Could not get file '%s'!\n", configPath);
-        }
-        MPI_Finalize();
-        exit(EXIT_FAILURE);
+        printf("[ERROR] Could not get file '%s'!\n", configPath);
+        stopAllProcesses(EXIT_FAILURE);
     }
 
     // read the contents
@@ -164,18 +240,173 @@ void getFromSettingsFile(char *configPath)
         {
             printvalues = atoi(configValue);
         }
+        else if (0 == strcmp(configKey, "THREADS_PER_RANK"))
+        {
+            threadsPerRank = atoi(configValue);
+        }
+        else if (0 == strcmp(configKey, "GHOST_DEPTH"))
+        {
+            ghostDepth = atoi(configValue);
+        }
+        else if (0 == strcmp(configKey, "HALO_MODE"))
+        {
+            haloMode = atoi(configValue);
+        }
+        else if (0 == strcmp(configKey, "SHARED_MEMORY"))
+        {
+            useSharedMemory = atoi(configValue);
+        }
+        else if (0 == strcmp(configKey, "REBALANCE_INTERVAL"))
+        {
+            rebalanceInterval = atoi(configValue);
+        }
+        else if (0 == strcmp(configKey, "STREAM_CHUNK"))
+        {
+            streamChunk = atoi(configValue);
+        }
+        else if (0 == strcmp(configKey, "OUTPUT_FILE"))
+        {
+            snprintf(outputFile, MAX_PATH_LENGTH, "%s", configValue);
+        }
+        else if (0 == strcmp(configKey, "SNAPSHOT_INTERVAL"))
+        {
+            snapshotInterval = atoi(configValue);
+        }
+        else if (0 == strcmp(configKey, "CHECKPOINT_INTERVAL"))
+        {
+            checkpointInterval = atoi(configValue);
+        }
+        else if (0 == strcmp(configKey, "CHECKPOINT_FILE"))
+        {
+            snprintf(checkpointFile, MAX_PATH_LENGTH, "%s", configValue);
+        }
+        else if (0 == strcmp(configKey, "RESTART_FILE"))
+        {
+            snprintf(restartFile, MAX_PATH_LENGTH, "%s", configValue);
+        }
         else
         {
-            if (id == FIRST)
-            {
-                printf("[INFO] Unrecognized settings key: '%s'\n", configKey);
-            }
+            printf("[INFO] Unrecognized settings key: '%s'\n", configKey);
         }
     }
 
     fclose(filePointer);
 }
 
+void getOptionsFromCmdLine(int nargc, char **argv, int first)
+{
+
+    for (int i = first; i < nargc; i++)
+    {
+
+        if (0 == strcmp(argv[i], "-s") || 0 == strcmp(argv[i], "--speed"))
+        {
+
+            waveSpeed = atof(argv[++i]);
+        }
+        else if (0 == strcmp(argv[i], "-t") || 0 == strcmp(argv[i], "--timesteps"))
+        {
+
+            tPoints = atoi(argv[++i]);
+        }
+        else if (0 == strcmp(argv[i], "-i") || 0 == strcmp(argv[i], "--intervalend"))
+        {
+
+            intervalEnd = atoi(argv[++i]);
+        }
+        else if (0 == strcmp(argv[i], "-n") || 0 == strcmp(argv[i], "--npoints"))
+        {
+
+            nPointsGlobal = atoi(argv[++i]);
+        }
+        else if (0 == strcmp(argv[i], "-p") || 0 == strcmp(argv[i], "--periods"))
+        {
+
+            periods = atof(argv[++i]);
+        }
+        else if (0 == strcmp(argv[i], "-a") || 0 == strcmp(argv[i], "--amplitude"))
+        {
+
+            amplitude = atof(argv[++i]);
+        }
+        else if (0 == strcmp(argv[i], "-l") || 0 == strcmp(argv[i], "--lambda"))
+        {
+
+            lambda = atof(argv[++i]);
+        }
+        else if (0 == strcmp(argv[i], "-u") || 0 == strcmp(argv[i], "--usegui"))
+        {
+
+            useGui = atoi(argv[++i]);
+        }
+        else if (0 == strcmp(argv[i], "-v") || 0 == strcmp(argv[i], "--printvalues"))
+        {
+
+            printvalues = atoi(argv[++i]);
+        }
+        else if (0 == strcmp(argv[i], "-r") || 0 == strcmp(argv[i], "--threads-per-rank"))
+        {
+
+            threadsPerRank = atoi(argv[++i]);
+        }
+        else if (0 == strcmp(argv[i], "-g") || 0 == strcmp(argv[i], "--ghost-depth"))
+        {
+
+            ghostDepth = atoi(argv[++i]);
+        }
+        else if (0 == strcmp(argv[i], "-m") || 0 == strcmp(argv[i], "--halo-mode"))
+        {
+
+            haloMode = atoi(argv[++i]);
+        }
+        else if (0 == strcmp(argv[i], "-w") || 0 == strcmp(argv[i], "--shared-memory"))
+        {
+
+            useSharedMemory = atoi(argv[++i]);
+        }
+        else if (0 == strcmp(argv[i], "-d") || 0 == strcmp(argv[i], "--rebalance-interval"))
+        {
+
+            rebalanceInterval = atoi(argv[++i]);
+        }
+        else if (0 == strcmp(argv[i], "-k") || 0 == strcmp(argv[i], "--stream-chunk"))
+        {
+
+            streamChunk = atoi(argv[++i]);
+        }
+        else if (0 == strcmp(argv[i], "-o") || 0 == strcmp(argv[i], "--output-file"))
+        {
+
+            snprintf(outputFile, MAX_PATH_LENGTH, "%s", argv[++i]);
+        }
+        else if (0 == strcmp(argv[i], "-e") || 0 == strcmp(argv[i], "--snapshot-interval"))
+        {
+
+            snapshotInterval = atoi(argv[++i]);
+        }
+        else if (0 == strcmp(argv[i], "-q") || 0 == strcmp(argv[i], "--checkpoint-interval"))
+        {
+
+            checkpointInterval = atoi(argv[++i]);
+        }
+        else if (0 == strcmp(argv[i], "-f") || 0 == strcmp(argv[i], "--checkpoint-file"))
+        {
+
+            snprintf(checkpointFile, MAX_PATH_LENGTH, "%s", argv[++i]);
+        }
+        else if (0 == strcmp(argv[i], "-R") || 0 == strcmp(argv[i], "--restart"))
+        {
+
+            snprintf(restartFile, MAX_PATH_LENGTH, "%s", argv[++i]);
+        }
+        else
+        {
+
+            printf("[INFO] Unrecognized argument: %s\n", argv[i]);
+        }
+    }
+}
+
 void getFromCmdLine(int nargc, char **argv)
 {
 
@@ -189,35 +420,28 @@ void getFromCmdLine(int nargc, char **argv)
     else if (0 == strcmp(argv[1], "-h") || 0 == strcmp(argv[1], "--help"))
     {
 
-        if (id == FIRST)
-        {
-            outputHelpMessage();
-        }
-        MPI_Finalize();
-        exit(EXIT_SUCCESS);
+        outputHelpMessage();
+        stopAllProcesses(EXIT_SUCCESS);
     }
     else if (0 == strcmp(argv[1], "-v") || 0 == strcmp(argv[1], "--version"))
     {
 
-        if (id == FIRST)
-        {
-            printf("Wave equation MPI - Psys18\nChris Rebbelin 2018\nVersion 0.1\n");
-        }
-        MPI_Finalize();
-        exit(EXIT_SUCCESS);
+        printf("Wave equation MPI - Psys18\nChris Rebbelin 2018\nVersion 0.1\n");
+        stopAllProcesses(EXIT_SUCCESS);
     }
     else if (0 == strcmp(argv[1], "-b") || 0 == strcmp(argv[1], "--benchmark"))
     {
 
-        if (nargc == 4)
+        if (nargc >= 4)
         {
 
             doBenchmark = 1;
 
-            // only number of timesteps and points can be set in benchmarks
-            // all other values are default
+            // number of timesteps and points are mandatory in benchmarks
+            // all other values are default unless given as options
             tPoints = atoi(argv[2]);
             nPointsGlobal = atoi(argv[3]);
+            getOptionsFromCmdLine(nargc, argv, 4);
 
             // visualization is disabled
             useGui = 0;
@@ -226,74 +450,13 @@ void getFromCmdLine(int nargc, char **argv)
         {
 
             // print help message and exit
-            if (id == FIRST)
-            {
-                outputHelpMessage();
-            }
-            MPI_Finalize();
-            exit(EXIT_FAILURE);
+            outputHelpMessage();
+            stopAllProcesses(EXIT_FAILURE);
         }
     }
     else
     {
-
-        for (int i = 1; i < nargc; i++)
-        {
-
-            if (0 == strcmp(argv[i], "-s") || 0 == strcmp(argv[i], "--speed"))
-            {
-
-                waveSpeed = atof(argv[++i]);
-            }
-            else if (0 == strcmp(argv[i], "-t") || 0 == strcmp(argv[i], "--timesteps"))
-            {
-
-                tPoints = atoi(argv[++i]);
-            }
-            else if (0 == strcmp(argv[i], "-i") || 0 == strcmp(argv[i], "--intervalend"))
-            {
-
-                intervalEnd = atoi(argv[++i]);
-            }
-            else if (0 == strcmp(argv[i], "-n") || 0 == strcmp(argv[i], "--npoints"))
-            {
-
-                nPointsGlobal = atoi(argv[++i]);
-            }
-            else if (0 == strcmp(argv[i], "-p") || 0 == strcmp(argv[i], "--periods"))
-            {
-
-                periods = atof(argv[++i]);
-            }
-            else if (0 == strcmp(argv[i], "-a") || 0 == strcmp(argv[i], "--amplitude"))
-            {
-
-                amplitude = atof(argv[++i]);
-            }
-            else if (0 == strcmp(argv[i], "-l") || 0 == strcmp(argv[i], "--lambda"))
-            {
-
-                lambda = atof(argv[++i]);
-            }
-            else if (0 == strcmp(argv[i], "-u") || 0 == strcmp(argv[i], "--usegui"))
-            {
-
-                useGui = atoi(argv[++i]);
-            }
-            else if (0 == strcmp(argv[i], "-v") || 0 == strcmp(argv[i], "--printvalues"))
-            {
-
-                printvalues = atoi(argv[++i]);
-            }
-            else
-            {
-
-                if (id == FIRST)
-                {
-                    printf("[INFO] Unrecognized argument: %s\n", argv[i]);
-                }
-            }
-        }
+        getOptionsFromCmdLine(nargc, argv, 1);
     }
 }
 
@@ -302,151 +465,267 @@ void checkParams()
 
     if (waveSpeed <= 0 || waveSpeed >= 1)
     {
-        if (id == FIRST)
-        {
-            printf("[ERROR] Wave equation not stable with c=%.3f!\n", waveSpeed);
-        }
-        MPI_Finalize();
-        exit(EXIT_FAILURE);
+        printf("[ERROR] Wave equation not stable with c=%.3f!\n", waveSpeed);
+        stopAllProcesses(EXIT_FAILURE);
     }
 
     if (tPoints < 0)
     {
-        if (id == FIRST)
-        {
-            printf("[ERROR] Number of time steps must not be negative!\n");
-        }
-        MPI_Finalize();
-        exit(EXIT_FAILURE);
+        printf("[ERROR] Number of time steps must not be negative!\n");
+        stopAllProcesses(EXIT_FAILURE);
     }
 
     if (intervalEnd < 10)
     {
-        if (id == FIRST)
-        {
-            printf("[ERROR] Right interval border must not be smaller than 10\n");
-        }
-        MPI_Finalize();
-        exit(EXIT_FAILURE);
+        printf("[ERROR] Right interval border must not be smaller than 10\n");
+        stopAllProcesses(EXIT_FAILURE);
     }
 
     if (nPointsGlobal <= 0)
     {
-        if (id == FIRST)
-        {
-            printf("[ERROR] Number of discrete points must not be negative or zero!\n");
-        }
-        MPI_Finalize();
-        exit(EXIT_FAILURE);
+        printf("[ERROR] Number of discrete points must not be negative or zero!\n");
+        stopAllProcesses(EXIT_FAILURE);
     }
 
     if (nPointsGlobal > MAX_POINTS)
     {
-        if (id == FIRST)
-        {
-            printf("[ERROR] Number of discrete points is bigger than the allowed maximum of %d!\n", MAX_POINTS);
-        }
-        MPI_Finalize();
-        exit(EXIT_FAILURE);
+        printf("[ERROR] Number of discrete points is bigger than the allowed maximum of %d!\n", MAX_POINTS);
+        stopAllProcesses(EXIT_FAILURE);
     }
 
     if (periods < 1)
     {
-        if (id == FIRST)
-        {
-            printf("[ERROR] Period length must not be smaller than 1!\n");
-        }
-        MPI_Finalize();
-        exit(EXIT_FAILURE);
+        printf("[ERROR] Period length must not be smaller than 1!\n");
+        stopAllProcesses(EXIT_FAILURE);
     }
 
     if (amplitude < 1)
     {
-        if (id == FIRST)
-        {
-            printf("[ERROR] Amplitude must not be smaller than 1!\n");
-        }
-        MPI_Finalize();
-        exit(EXIT_FAILURE);
+        printf("[ERROR] Amplitude must not be smaller than 1!\n");
+        stopAllProcesses(EXIT_FAILURE);
     }
 
     if (lambda < 0)
     {
-        if (id == FIRST)
-        {
-            printf("[ERROR] Dampening factor must not be negative!\n");
-        }
-        MPI_Finalize();
-        exit(EXIT_FAILURE);
+        printf("[ERROR] Dampening factor must not be negative!\n");
+        stopAllProcesses(EXIT_FAILURE);
     }
 
     if (lambda > MAX_LAMBDA)
     {
-        if (id == FIRST)
-        {
-            printf("[ERROR] Dampening factor must not be greater than %.2f!\n", MAX_LAMBDA);
-        }
-        MPI_Finalize();
-        exit(EXIT_FAILURE);
+        printf("[ERROR] Dampening factor must not be greater than %.2f!\n", MAX_LAMBDA);
+        stopAllProcesses(EXIT_FAILURE);
     }
 
     if (!useGui && tPoints == 0)
     {
-        if (id == FIRST)
-        {
-            printf("[ERROR] Simulating an endless loop is only allowed with visualisation enabled!\n");
-        }
-        MPI_Finalize();
-        exit(EXIT_FAILURE);
+        printf("[ERROR] Simulating an endless loop is only allowed with visualisation enabled!\n");
+        stopAllProcesses(EXIT_FAILURE);
     }
 
-    deltaX = (intervalEnd / nPointsGlobal);
+    if (threadsPerRank < 0)
+    {
+        printf("[ERROR] Number of threads per process must not be negative!\n");
+        stopAllProcesses(EXIT_FAILURE);
+    }
 
-    c = (DELTA_T / deltaX) * waveSpeed;
-    cSquared = c * c;
+    if (ghostDepth < 1)
+    {
+        printf("[ERROR] Ghost depth must be at least 1!\n");
+        stopAllProcesses(EXIT_FAILURE);
+    }
 
-    if (id == FIRST)
+    // the ghost points of a process must come from its direct neighbors only
+    if ((nPointsGlobal - 1) / numberOfProcesses < ghostDepth)
     {
+        printf("[ERROR] Every process needs at least %d points for a ghost depth of %d, use fewer processes or a smaller ghost depth!\n", ghostDepth, ghostDepth);
+        stopAllProcesses(EXIT_FAILURE);
+    }
 
-        if (tPoints == 0)
-        {
-            printf("Looping forever");
-        }
-        else
-        {
-            printf("Simulating %d time steps", tPoints);
-        }
-        printf(" with parameters:\n");
-        printf("Using %d discrete points in line interval [0,%d] with speed %.3f\n", nPointsGlobal, intervalEnd, waveSpeed);
-        printf("Simulating a %sdampened", lambda == 0 ? "un" : "");
-        printf(" sine wave with amplitude %d and %d periods", amplitude, periods);
-        if (lambda != 0)
-        {
-            printf(" and damping factor %f", lambda);
-        }
+    if (haloMode != HALO_MESSAGES && haloMode != HALO_PERSISTENT && haloMode != HALO_RMA)
+    {
+        printf("[ERROR] Unknown halo mode %d!\n", haloMode);
+        stopAllProcesses(EXIT_FAILURE);
+    }
 
-        printf("\n");
+    if (rebalanceInterval < 0)
+    {
+        printf("[ERROR] Rebalance interval must not be negative!\n");
+        stopAllProcesses(EXIT_FAILURE);
     }
-}
 
-void getUserInputOrConfig(int numberofargc, char **argv, int pid, int pnum)
-{
+    if (streamChunk < 0)
+    {
+        printf("[ERROR] Stream chunk size must not be negative!\n");
+        stopAllProcesses(EXIT_FAILURE);
+    }
 
-    if (pnum < 2) {
-        if (pid == FIRST)
-        {
-            printf("[ERROR] At least 2 processes needed!\n");
-        }
-        MPI_Finalize();
-        exit(EXIT_FAILURE);
+    // the visualization needs the whole wave on the master
+    if (streamChunk > 0 && useGui)
+    {
+        printf("[ERROR] Streaming mode can not be used with the visualization!\n");
+        stopAllProcesses(EXIT_FAILURE);
     }
 
-    // set id and number of processes once
-    // so subsequent functions don't need to pass those values again
-    id = pid;
-    numberOfProcesses = pnum;
+    if (snapshotInterval < 0)
+    {
+        printf("[ERROR] Snapshot interval must not be negative!\n");
+        stopAllProcesses(EXIT_FAILURE);
+    }
 
-    LAST = pnum - 1;
+    if (outputFile[0] != '\0' && useGui)
+    {
+        printf("[ERROR] The output file can not be written with the visualization!\n");
+        stopAllProcesses(EXIT_FAILURE);
+    }
+
+    if (checkpointInterval < 0)
+    {
+        printf("[ERROR] Checkpoint interval must not be negative!\n");
+        stopAllProcesses(EXIT_FAILURE);
+    }
+
+    if (checkpointInterval > 0 && useGui)
+    {
+        printf("[ERROR] Checkpoints can not be written with the visualization!\n");
+        stopAllProcesses(EXIT_FAILURE);
+    }
+
+    // the visualization and every benchmark run reset the wave and would drop the restarted state
+    if (restartFile[0] != '\0' && (useGui || doBenchmark))
+    {
+        printf("[ERROR] A restart can not be combined with the visualization or a benchmark!\n");
+        stopAllProcesses(EXIT_FAILURE);
+    }
+
+    if (tPoints == 0)
+    {
+        printf("Looping forever");
+    }
+    else
+    {
+        printf("Simulating %d time steps", tPoints);
+    }
+    printf(" with parameters:\n");
+    printf("Using %d discrete points in line interval [0,%d] with speed %.3f\n", nPointsGlobal, intervalEnd, waveSpeed);
+    printf("Simulating a %sdampened", lambda == 0 ? "un" : "");
+    printf(" sine wave with amplitude %d and %d periods", amplitude, periods);
+    if (lambda != 0)
+    {
+        printf(" and damping factor %f", lambda);
+    }
+
+    printf("\n");
+}
+
+void broadcastSettings(int status)
+{
+
+    WaveSettings settings;
+
+    if (id == FIRST)
+    {
+        settings.waveSpeed = waveSpeed;
+        settings.lambda = lambda;
+        settings.intervalEnd = intervalEnd;
+        settings.nPointsGlobal = nPointsGlobal;
+        settings.tPoints = tPoints;
+        settings.periods = periods;
+        settings.amplitude = amplitude;
+        settings.useGui = useGui;
+        settings.printvalues = printvalues;
+        settings.doBenchmark = doBenchmark;
+        settings.threadsPerRank = threadsPerRank;
+        settings.ghostDepth = ghostDepth;
+        settings.haloMode = haloMode;
+        settings.useSharedMemory = useSharedMemory;
+        settings.rebalanceInterval = rebalanceInterval;
+        settings.streamChunk = streamChunk;
+        settings.snapshotInterval = snapshotInterval;
+        settings.checkpointInterval = checkpointInterval;
+        settings.status = status;
+        memcpy(settings.outputFile, outputFile, MAX_PATH_LENGTH);
+        memcpy(settings.checkpointFile, checkpointFile, MAX_PATH_LENGTH);
+        memcpy(settings.restartFile, restartFile, MAX_PATH_LENGTH);
+    }
+
+    // all processes run the same program on the same kind of machine, so the struct can be sent as bytes
+    CHECK(MPI_Bcast(&settings, sizeof(WaveSettings), MPI_BYTE, FIRST, waveComm));
+
+    if (id != FIRST)
+    {
+        waveSpeed = settings.waveSpeed;
+        lambda = settings.lambda;
+        intervalEnd = settings.intervalEnd;
+        nPointsGlobal = settings.nPointsGlobal;
+        tPoints = settings.tPoints;
+        periods = settings.periods;
+        amplitude = settings.amplitude;
+        useGui = settings.useGui;
+        printvalues = settings.printvalues;
+        doBenchmark = settings.doBenchmark;
+        threadsPerRank = settings.threadsPerRank;
+        ghostDepth = settings.ghostDepth;
+        haloMode = settings.haloMode;
+        useSharedMemory = settings.useSharedMemory;
+        rebalanceInterval = settings.rebalanceInterval;
+        streamChunk = settings.streamChunk;
+        snapshotInterval = settings.snapshotInterval;
+        checkpointInterval = settings.checkpointInterval;
+        memcpy(outputFile, settings.outputFile, MAX_PATH_LENGTH);
+        memcpy(checkpointFile, settings.checkpointFile, MAX_PATH_LENGTH);
+        memcpy(restartFile, settings.restartFile, MAX_PATH_LENGTH);
+    }
+
+    // the master already printed why
+    if (settings.status != SETTINGS_VALID)
+    {
+        MPI_Finalize();
+        exit(settings.status);
+    }
+}
+
+void stopAllProcesses(int exitCode)
+{
+    broadcastSettings(exitCode);
+}
+
+void applySettings()
+{
+
+    // without THREADS_PER_RANK or OMP_NUM_THREADS one thread per process,
+    // the OpenMP default of one thread per core would oversubscribe a node with several processes
+    if (threadsPerRank > 0)
+    {
+        omp_set_num_threads(threadsPerRank);
+    }
+    else if (getenv("OMP_NUM_THREADS") == NULL)
+    {
+        omp_set_num_threads(1);
+    }
+
+    deltaX = (intervalEnd / nPointsGlobal);
+
+    c = (DELTA_T / deltaX) * waveSpeed;
+    cSquared = c * c;
+}
+
+void getUserInputOrConfig(int numberofargc, char **argv, int pnum)
+{
+
+    const int dims[1] = {pnum};
+    const int periodic[1] = {0};
+
+    // the MPI library may renumber the processes to place neighboring slabs on neighboring cores or nodes
+    CHECK(MPI_Cart_create(MPI_COMM_WORLD, 1, dims, periodic, 1, &waveComm));
+    CHECK(MPI_Cart_shift(waveComm, 0, 1, &leftNeighbor, &rightNeighbor));
+
+    // set id and number of processes once
+    // so subsequent functions don't need to pass those values again
+    CHECK(MPI_Comm_rank(waveComm, &id));
+    numberOfProcesses = pnum;
+
+    LAST = pnum - 1;
 
     // set the default values
     // will be used if not overwritten
@@ -459,160 +738,1247 @@ void getUserInputOrConfig(int numberofargc, char **argv, int pid, int pnum)
     lambda = 0;
     useGui = 1;
     printvalues = 0;
+    threadsPerRank = 0;
+    ghostDepth = 1;
+    haloMode = HALO_MESSAGES;
+    useSharedMemory = 0;
+    rebalanceInterval = 0;
+    streamChunk = 0;
+    outputFile[0] = '\0';
+    snapshotInterval = 0;
+    checkpointInterval = 0;
+    snprintf(checkpointFile, MAX_PATH_LENGTH, "%s", DEFAULT_CHECKPOINT_FILE);
+    restartFile[0] = '\0';
+
+    // only the master reads and checks the settings, the others wait for the result
+    if (id == FIRST)
+    {
+
+        if (numberofargc > 1)
+        {
+            getFromCmdLine(numberofargc, argv);
+        }
+        else
+        {
+            // no cmd args, use default settings file
+            getFromSettingsFile(DEFAULT_SETTINGS_FILE_PATH);
+        }
+
+        // check values for validity
+        checkParams();
+    }
+
+    broadcastSettings(SETTINGS_VALID);
+    applySettings();
+
+    outputLayout();
+}
+
+void outputLayout()
+{
+
+    MPI_Comm nodeComm;
+    int ranksOnNode, nodeId, numberOfNodes;
+
+    // processes sharing memory are on the same node
+    CHECK(MPI_Comm_split_type(waveComm, MPI_COMM_TYPE_SHARED, id, MPI_INFO_NULL, &nodeComm));
+    CHECK(MPI_Comm_size(nodeComm, &ranksOnNode));
+    CHECK(MPI_Comm_rank(nodeComm, &nodeId));
+
+    // count the nodes by their first process
+    nodeId = (nodeId == 0);
+    CHECK(MPI_Reduce(&nodeId, &numberOfNodes, 1, MPI_INT, MPI_SUM, FIRST, waveComm));
+
+    if (id == FIRST)
+    {
+        printf("Using %d processes on %d node%s (%d on the first) with %d thread%s each\n", numberOfProcesses, numberOfNodes, numberOfNodes == 1 ? "" : "s",
+               ranksOnNode, omp_get_max_threads(), omp_get_max_threads() == 1 ? "" : "s");
+    }
+
+    CHECK(MPI_Comm_free(&nodeComm));
+}
+
+double waveInitFunc(double x)
+{
+    // divide by (intervalEnd - 1) to satisfy the right border condition
+    // necessary because 1000 points means indices 0 to 999
+    return (amplitude * sin(2 * x * M_PI * periods / (intervalEnd - 1)));
+}
+
+void initWaveConditions()
+{
+
+    int ranksOnNode;
+
+    // processes sharing memory are on the same node
+    CHECK(MPI_Comm_split_type(waveComm, MPI_COMM_TYPE_SHARED, id, MPI_INFO_NULL, &nodeComm));
+    CHECK(MPI_Comm_size(nodeComm, &ranksOnNode));
+
+    // all processes can read their neighbors' points directly, so they need no halo exchange
+    sharedMemoryActive = useSharedMemory && ranksOnNode == numberOfProcesses;
+
+    // the shared wave needs no halo exchange and keeps its slabs, these settings would be dropped,
+    // on several nodes the wave is not shared and they are used, all processes stop here together
+    if (sharedMemoryActive && (ghostDepth != 1 || haloMode != HALO_MESSAGES || rebalanceInterval != 0))
+    {
+        if (id == FIRST)
+        {
+            printf("[ERROR] Ghost depth, halo mode and rebalancing can not be combined with shared memory on one node!\n");
+        }
+        MPI_Finalize();
+        exit(EXIT_FAILURE);
+    }
+
+    if (sharedMemoryActive && id == FIRST)
+    {
+        printf("All processes run on one node, sharing the wave in memory\n");
+    }
+
+    // calculate the points owned by every process
+    const int firstOwned = (int) (((long) id * (nPointsGlobal - 1)) / numberOfProcesses);
+    const int lastOwned = (id == LAST) ? nPointsGlobal - 1 : (int) (((long) (id + 1) * (nPointsGlobal - 1)) / numberOfProcesses) - 1;
+
+    // and add the ghost points of the neighbors
+    ghostsLeft = (id == FIRST) ? 0 : ghostDepth;
+    ghostsRight = (id == LAST) ? 0 : ghostDepth;
+
+    left = firstOwned - ghostsLeft;
+    right = lastOwned + ghostsRight;
+    nPointsLocal = right + 1 - left;
+    ownedPoints = lastOwned + 1 - firstOwned;
+
+    // allocate space for local arrays
+    if (sharedMemoryActive)
+    {
+        allocateSharedSteps();
+    }
+    else
+    {
+        const size_t bufSize = nPointsLocal * sizeof(double);
+        previousStep = (double *) malloc(bufSize);
+        currentStep = (double *) malloc(bufSize);
+        nextStep = (double *) malloc(bufSize);
+    }
+
+    // master needs to know where the points of every process go, all others need it for rebalancing
+    recvCounts = (int *) malloc(numberOfProcesses * sizeof(int));
+    displacements = (int *) malloc(numberOfProcesses * sizeof(int));
+
+    CHECK(MPI_Allgather(&ownedPoints, 1, MPI_INT, recvCounts, 1, MPI_INT, waveComm));
+
+    displacements[0] = 0;
+    for (int i = 1; i < numberOfProcesses; i++)
+    {
+        displacements[i] = displacements[i - 1] + recvCounts[i - 1];
+    }
+
+    if (id == FIRST)
+    {
+
+        // master needs another global array to collect everything in the end
+        // or only a small one for a single chunk in streaming mode
+        // with shared memory, the whole wave is already there
+        if (streamChunk > 0)
+        {
+            streamBuffer = (double *) malloc(streamChunk * sizeof(double));
+        }
+        else if (!sharedMemoryActive)
+        {
+            globalStep = (double *) malloc(nPointsGlobal * sizeof(double));
+        }
+    }
+
+    if (!sharedMemoryActive)
+    {
+        initHaloExchange();
+    }
+
+    resetWave();
+
+    if (restartFile[0] != '\0')
+    {
+        readCheckpoint();
+    }
+}
+
+void allocateSharedSteps()
+{
+
+    double **steps[3] = {&previousStep, &currentStep, &nextStep};
+    double *ownPoints, *lineStart;
+    MPI_Aint windowSize;
+    int displacementUnit;
+
+    for (int i = 0; i < 3; i++)
+    {
+
+        // the points of all processes form one contiguous line in the order of the ranks
+        CHECK(MPI_Win_allocate_shared(ownedPoints * sizeof(double), sizeof(double), MPI_INFO_NULL, nodeComm, &ownPoints, &stepWindows[i]));
+        CHECK(MPI_Win_shared_query(stepWindows[i], FIRST, &windowSize, &displacementUnit, &lineStart));
+
+        // the window stays open for direct loads and stores, synchronized with MPI_Win_sync
+        CHECK(MPI_Win_lock_all(MPI_MODE_NOCHECK, stepWindows[i]));
+
+        *steps[i] = lineStart + left;
+    }
+}
+
+void syncSharedSteps()
+{
+
+    // make the own points visible to the neighbors and wait until they are done with theirs
+    for (int i = 0; i < 3; i++)
+    {
+        CHECK(MPI_Win_sync(stepWindows[i]));
+    }
+
+    CHECK(MPI_Barrier(nodeComm));
+
+    for (int i = 0; i < 3; i++)
+    {
+        CHECK(MPI_Win_sync(stepWindows[i]));
+    }
+}
+
+void initHaloExchange()
+{
+
+    // a halo holds ghostDepth current values and ghostDepth - 1 previous values
+    haloSize = 2 * ghostDepth - 1;
+    sendLeft = (double *) malloc(haloSize * sizeof(double));
+    sendRight = (double *) malloc(haloSize * sizeof(double));
+
+    if (haloMode == HALO_RMA)
+    {
+
+        int neighbors[2], numberOfNeighbors = 0;
+        MPI_Group lineGroup;
+
+        // the neighbors put their halos directly into the recieve buffers: the left one at 0, the right one at haloSize
+        CHECK(MPI_Win_allocate(2 * haloSize * sizeof(double), sizeof(double), MPI_INFO_NULL, waveComm, &recvLeft, &haloWindow));
+        recvRight = recvLeft + haloSize;
+
+        if (leftNeighbor != MPI_PROC_NULL)
+        {
+            neighbors[numberOfNeighbors++] = leftNeighbor;
+        }
+
+        if (rightNeighbor != MPI_PROC_NULL)
+        {
+            neighbors[numberOfNeighbors++] = rightNeighbor;
+        }
+
+        CHECK(MPI_Comm_group(waveComm, &lineGroup));
+        CHECK(MPI_Group_incl(lineGroup, numberOfNeighbors, neighbors, &neighborGroup));
+        CHECK(MPI_Group_free(&lineGroup));
+    }
+    else
+    {
+        recvLeft = (double *) malloc(haloSize * sizeof(double));
+        recvRight = (double *) malloc(haloSize * sizeof(double));
+    }
+
+    // the halo messages always use the same buffers and neighbors, so the requests can be set up only once
+    if (haloMode == HALO_PERSISTENT)
+    {
+        CHECK(MPI_Recv_init(recvLeft, haloSize, MPI_DOUBLE, leftNeighbor, L_TO_R, waveComm, &haloRequests[0]));
+        CHECK(MPI_Send_init(sendLeft, haloSize, MPI_DOUBLE, leftNeighbor, R_TO_L, waveComm, &haloRequests[1]));
+        CHECK(MPI_Recv_init(recvRight, haloSize, MPI_DOUBLE, rightNeighbor, R_TO_L, waveComm, &haloRequests[2]));
+        CHECK(MPI_Send_init(sendRight, haloSize, MPI_DOUBLE, rightNeighbor, L_TO_R, waveComm, &haloRequests[3]));
+    }
+}
+
+void calculateRange(int from, int to)
+{
+
+    int i;
+    const double start = MPI_Wtime();
+
+    // the threads of this process share the range, only the master thread communicates (MPI_THREAD_FUNNELED)
+    #pragma omp parallel for if(to - from >= MIN_POINTS_PER_THREAD) shared(nextStep, currentStep, previousStep, cSquared, from, to) private(i)
+    for (i = from; i < to; i++)
+    {
+        nextStep[i] = 2.0 * currentStep[i] - previousStep[i] + cSquared * (currentStep[i - 1] - (2.0 * currentStep[i]) + currentStep[i + 1]);
+    }
+
+    // without the time waiting for the neighbors
+    const double elapsed = MPI_Wtime() - start;
+    computeTime += elapsed;
+    phaseTimes[PHASE_COMPUTE] += elapsed;
+}
+
+void packHalo(double *halo, int start, int previousOffset)
+{
+
+    int k;
+
+    for (k = 0; k < ghostDepth; k++)
+    {
+        halo[k] = nextStep[start + k];
+    }
+
+    // the outermost ghost point is never updated, so it needs no previous value
+    for (k = 0; k < ghostDepth - 1; k++)
+    {
+        halo[ghostDepth + k] = currentStep[start + previousOffset + k];
+    }
+}
+
+void unpackHalo(const double *halo, int start, int previousOffset)
+{
+
+    int k;
+
+    for (k = 0; k < ghostDepth; k++)
+    {
+        nextStep[start + k] = halo[k];
+    }
+
+    for (k = 0; k < ghostDepth - 1; k++)
+    {
+        currentStep[start + previousOffset + k] = halo[ghostDepth + k];
+    }
+}
+
+void exchangeHalos(int from, int to)
+{
+
+    // first the points the neighbors need as ghost points, they are waiting for them
+    int leftEdge = from, rightEdge = to;
+
+    if (ghostsLeft > 0)
+    {
+        leftEdge = (from + ghostDepth < to) ? from + ghostDepth : to;
+    }
+
+    if (ghostsRight > 0)
+    {
+        rightEdge = (to - ghostDepth > leftEdge) ? to - ghostDepth : leftEdge;
+    }
+
+    calculateRange(from, leftEdge);
+    calculateRange(rightEdge, to);
+
+    double start = MPI_Wtime();
+
+    // exchange ghost points with the neighbors, the ends of the line send to and recieve from MPI_PROC_NULL
+    if (ghostsLeft > 0)
+    {
+        packHalo(sendLeft, ghostDepth, 0);
+    }
+
+    if (ghostsRight > 0)
+    {
+        packHalo(sendRight, nPointsLocal - 2 * ghostDepth, 1);
+    }
+
+    if (haloMode == HALO_PERSISTENT)
+    {
+        CHECK(MPI_Startall(4, haloRequests));
+    }
+    else if (haloMode == HALO_RMA)
+    {
+
+        // open the own buffers for the neighbors and write into theirs
+        CHECK(MPI_Win_post(neighborGroup, 0, haloWindow));
+        CHECK(MPI_Win_start(neighborGroup, 0, haloWindow));
+
+        CHECK(MPI_Put(sendLeft, haloSize, MPI_DOUBLE, leftNeighbor, haloSize, haloSize, MPI_DOUBLE, haloWindow));
+        CHECK(MPI_Put(sendRight, haloSize, MPI_DOUBLE, rightNeighbor, 0, haloSize, MPI_DOUBLE, haloWindow));
+    }
+    else
+    {
+
+        CHECK(MPI_Irecv(recvLeft, haloSize, MPI_DOUBLE, leftNeighbor, L_TO_R, waveComm, &haloRequests[0]));
+        CHECK(MPI_Isend(sendLeft, haloSize, MPI_DOUBLE, leftNeighbor, R_TO_L, waveComm, &haloRequests[1]));
+        CHECK(MPI_Irecv(recvRight, haloSize, MPI_DOUBLE, rightNeighbor, R_TO_L, waveComm, &haloRequests[2]));
+        CHECK(MPI_Isend(sendRight, haloSize, MPI_DOUBLE, rightNeighbor, L_TO_R, waveComm, &haloRequests[3]));
+    }
+
+    phaseTimes[PHASE_HALO] += MPI_Wtime() - start;
+
+    // the interior points don't depend on the neighbors, calculate them while the messages are in flight
+    calculateRange(leftEdge, rightEdge);
+
+    start = MPI_Wtime();
+
+    if (haloMode == HALO_RMA)
+    {
+        // finish the own puts, then wait for the ones of the neighbors
+        CHECK(MPI_Win_complete(haloWindow));
+        CHECK(MPI_Win_wait(haloWindow));
+    }
+    else
+    {
+        CHECK(MPI_Waitall(4, haloRequests, MPI_STATUSES_IGNORE));
+    }
+
+    const double arrived = MPI_Wtime();
+    phaseTimes[PHASE_WAIT] += arrived - start;
+
+    if (ghostsLeft > 0)
+    {
+        unpackHalo(recvLeft, 0, 1);
+    }
+
+    if (ghostsRight > 0)
+    {
+        unpackHalo(recvRight, nPointsLocal - ghostDepth, 0);
+    }
+
+    phaseTimes[PHASE_HALO] += MPI_Wtime() - arrived;
+}
+
+void simulateOneTimeStep()
+{
+
+    if (sharedMemoryActive)
+    {
+        simulateSharedTimeStep();
+        return;
+    }
+
+    // with ghostDepth ghost points, the valid points shrink by one per step on every side with ghost points
+    // until the neighbors refresh them after ghostDepth steps
+    const int stepsLeft = ghostDepth - stepInBlock++;
+    const int from = (id == FIRST) ? 1 : stepInBlock;
+    const int to = (id == LAST) ? nPointsLocal - 1 : nPointsLocal - stepInBlock;
+
+    stepsDone++;
+    stepsSinceRebalance++;
+
+    if (stepsLeft > 1)
+    {
+        calculateRange(from, to);
+    }
+    else
+    {
+        exchangeHalos(from, to);
+        stepInBlock = 0;
+    }
+
+    // boundary conditions at both ends of the line
+    if (id == FIRST)
+    {
+        nextStep[0] = 0.0;
+    }
+
+    if (id == LAST)
+    {
+        nextStep[nPointsLocal - 1] = 0.0;
+    }
+
+    // copy values one step "into the past"
+    double *tempStep = previousStep;
+    previousStep = currentStep;
+    currentStep = nextStep;
+    nextStep = tempStep;
+
+    // all ghost points are valid right after an exchange, so the points can be moved now
+    if (rebalanceInterval > 0 && stepInBlock == 0 && stepsSinceRebalance >= rebalanceInterval)
+    {
+        const double start = MPI_Wtime();
+        rebalanceSlabs();
+        phaseTimes[PHASE_REBALANCE] += MPI_Wtime() - start;
+    }
+}
+
+void rebalanceSlabs()
+{
+
+    int *newCounts = (int *) malloc(numberOfProcesses * sizeof(int));
+    double *computeTimes = NULL;
+
+    if (id == FIRST)
+    {
+        computeTimes = (double *) malloc(numberOfProcesses * sizeof(double));
+    }
+
+    CHECK(MPI_Gather(&computeTime, 1, MPI_DOUBLE, computeTimes, 1, MPI_DOUBLE, FIRST, waveComm));
+
+    // the master decides for everyone, so all processes use the same partition
+    if (id == FIRST)
+    {
+        calculateNewCounts(computeTimes, newCounts);
+        free(computeTimes);
+    }
+
+    CHECK(MPI_Bcast(newCounts, numberOfProcesses, MPI_INT, FIRST, waveComm));
+
+    if (0 != memcmp(newCounts, recvCounts, numberOfProcesses * sizeof(int)))
+    {
+        migratePoints(newCounts);
+    }
+
+    free(newCounts);
+
+    computeTime = 0.0;
+    stepsSinceRebalance = 0;
+}
+
+void calculateNewCounts(const double *computeTimes, int *newCounts)
+{
+
+    int slowest = 0, fastest = 0, assigned = 0, moved = 0;
+    double totalSpeed = 0.0;
+
+    memcpy(newCounts, recvCounts, numberOfProcesses * sizeof(int));
+
+    for (int i = 1; i < numberOfProcesses; i++)
+    {
+
+        if (computeTimes[i] > computeTimes[slowest])
+        {
+            slowest = i;
+        }
+
+        if (computeTimes[i] < computeTimes[fastest])
+        {
+            fastest = i;
+        }
+    }
+
+    // small differences are noise
+    if (computeTimes[slowest] <= (1.0 + REBALANCE_THRESHOLD) * computeTimes[fastest] || computeTimes[fastest] <= 0.0)
+    {
+        return;
+    }
+
+    // points per second of every process
+    for (int i = 0; i < numberOfProcesses; i++)
+    {
+        totalSpeed += recvCounts[i] / computeTimes[i];
+    }
+
+    // move halfway to a share proportional to the speed, so a single noisy interval does not overshoot
+    for (int i = 0; i < numberOfProcesses; i++)
+    {
+
+        const double share = nPointsGlobal * (recvCounts[i] / computeTimes[i]) / totalSpeed;
+
+        newCounts[i] = (int) ((recvCounts[i] + share) / 2.0);
+
+        // the ghost points must come from the direct neighbors
+        if (newCounts[i] < ghostDepth)
+        {
+            newCounts[i] = ghostDepth;
+        }
+        assigned += newCounts[i];
+    }
+
+    // fix the rounding, the largest processes give up points if there are too many
+    newCounts[LAST] += (assigned < nPointsGlobal) ? nPointsGlobal - assigned : 0;
+    assigned = (assigned < nPointsGlobal) ? nPointsGlobal : assigned;
+
+    while (assigned > nPointsGlobal)
+    {
+
+        int largest = 0;
+
+        for (int i = 1; i < numberOfProcesses; i++)
+        {
+            if (newCounts[i] > newCounts[largest])
+            {
+                largest = i;
+            }
+        }
+
+        const int surplus = (assigned - nPointsGlobal < newCounts[largest] - ghostDepth) ? assigned - nPointsGlobal : newCounts[largest] - ghostDepth;
+        newCounts[largest] -= surplus;
+        assigned -= surplus;
+    }
+
+    // every moved point crosses at least one border
+    for (int i = 0, oldStart = 0, newStart = 0; i < numberOfProcesses - 1; i++)
+    {
+        oldStart += recvCounts[i];
+        newStart += newCounts[i];
+        moved += abs(newStart - oldStart);
+    }
+
+    printf("[INFO] Step %d: process %d took %.1f%% longer than process %d, moving %d point%s between the processes\n", stepsDone, slowest,
+           100.0 * (computeTimes[slowest] / computeTimes[fastest] - 1.0), fastest, moved, moved == 1 ? "" : "s");
+}
+
+void migratePoints(const int *newCounts)
+{
+
+    int *sendCounts = (int *) malloc(numberOfProcesses * sizeof(int));
+    int *sendDisplacements = (int *) malloc(numberOfProcesses * sizeof(int));
+    int *newPointCounts = (int *) malloc(numberOfProcesses * sizeof(int));
+    int *newDisplacements = (int *) malloc(numberOfProcesses * sizeof(int));
+
+    // new local range of every process, including its ghost points
+    int newStart = 0, myNewLeft = 0, myNewRight = 0;
+
+    for (int i = 0; i < numberOfProcesses; i++)
+    {
+
+        const int newLeft = newStart - ((i == FIRST) ? 0 : ghostDepth);
+        const int newRight = newStart + newCounts[i] - 1 + ((i == LAST) ? 0 : ghostDepth);
+
+        if (i == id)
+        {
+            myNewLeft = newLeft;
+            myNewRight = newRight;
+        }
+
+        // own points the process needs
+        const int sendFrom = (newLeft > displacements[id]) ? newLeft : displacements[id];
+        const int sendTo = (newRight < displacements[id] + ownedPoints - 1) ? newRight : displacements[id] + ownedPoints - 1;
+
+        sendCounts[i] = (sendTo >= sendFrom) ? sendTo - sendFrom + 1 : 0;
+        sendDisplacements[i] = sendFrom - left;
+
+        newStart += newCounts[i];
+    }
+
+    // points of the other processes needed here
+    for (int i = 0; i < numberOfProcesses; i++)
+    {
+
+        const int recvFrom = (myNewLeft > displacements[i]) ? myNewLeft : displacements[i];
+        const int recvTo = (myNewRight < displacements[i] + recvCounts[i] - 1) ? myNewRight : displacements[i] + recvCounts[i] - 1;
+
+        newPointCounts[i] = (recvTo >= recvFrom) ? recvTo - recvFrom + 1 : 0;
+        newDisplacements[i] = recvFrom - myNewLeft;
+    }
+
+    const size_t bufSize = (myNewRight + 1 - myNewLeft) * sizeof(double);
+    double *newPrevious = (double *) malloc(bufSize);
+    double *newCurrent = (double *) malloc(bufSize);
+
+    // only the processes that actually exchange points talk to each other, for small shifts these are the direct neighbors
+    MPI_Request *requests = (MPI_Request *) malloc(4 * numberOfProcesses * sizeof(MPI_Request));
+    int requestCount = 0;
+
+    for (int i = 0; i < numberOfProcesses; i++)
+    {
+
+        if (i == id)
+        {
+            memcpy(&newPrevious[newDisplacements[i]], &previousStep[sendDisplacements[i]], sendCounts[i] * sizeof(double));
+            memcpy(&newCurrent[newDisplacements[i]], &currentStep[sendDisplacements[i]], sendCounts[i] * sizeof(double));
+            continue;
+        }
+
+        if (newPointCounts[i] > 0)
+        {
+            CHECK(MPI_Irecv(&newPrevious[newDisplacements[i]], newPointCounts[i], MPI_DOUBLE, i, MIGRATE_PREVIOUS, waveComm, &requests[requestCount++]));
+            CHECK(MPI_Irecv(&newCurrent[newDisplacements[i]], newPointCounts[i], MPI_DOUBLE, i, MIGRATE_CURRENT, waveComm, &requests[requestCount++]));
+        }
+
+        if (sendCounts[i] > 0)
+        {
+            CHECK(MPI_Isend(&previousStep[sendDisplacements[i]], sendCounts[i], MPI_DOUBLE, i, MIGRATE_PREVIOUS, waveComm, &requests[requestCount++]));
+            CHECK(MPI_Isend(&currentStep[sendDisplacements[i]], sendCounts[i], MPI_DOUBLE, i, MIGRATE_CURRENT, waveComm, &requests[requestCount++]));
+        }
+    }
+
+    CHECK(MPI_Waitall(requestCount, requests, MPI_STATUSES_IGNORE));
+    free(requests);
+
+    free(previousStep);
+    free(currentStep);
+    free(nextStep);
+
+    previousStep = newPrevious;
+    currentStep = newCurrent;
+    nextStep = (double *) malloc(bufSize);
+
+    left = myNewLeft;
+    right = myNewRight;
+    nPointsLocal = right + 1 - left;
+    ownedPoints = newCounts[id];
+
+    memcpy(recvCounts, newCounts, numberOfProcesses * sizeof(int));
+
+    displacements[0] = 0;
+    for (int i = 1; i < numberOfProcesses; i++)
+    {
+        displacements[i] = displacements[i - 1] + recvCounts[i - 1];
+    }
+
+    free(sendCounts);
+    free(sendDisplacements);
+    free(newPointCounts);
+    free(newDisplacements);
+}
+
+void simulateSharedTimeStep()
+{
+
+    // the ghost points are the neighbors' points of the last step, which are always valid
+    calculateRange(1, nPointsLocal - 1);
+
+    // boundary conditions at both ends of the line
+    if (id == FIRST)
+    {
+        nextStep[0] = 0.0;
+    }
+
+    if (id == LAST)
+    {
+        nextStep[nPointsLocal - 1] = 0.0;
+    }
+
+    // the neighbors must be done with this step before anyone reads it
+    const double start = MPI_Wtime();
+    syncSharedSteps();
+    phaseTimes[PHASE_WAIT] += MPI_Wtime() - start;
+
+    // copy values one step "into the past"
+    double *tempStep = previousStep;
+    previousStep = currentStep;
+    currentStep = nextStep;
+    nextStep = tempStep;
+}
+
+double simulateNumberOfTimeSteps()
+{
+
+    double elapsed, start, wtime = MPI_Wtime();
+
+    if (outputFile[0] != '\0')
+    {
+        openOutputFile();
+    }
+
+    if (checkpointInterval > 0)
+    {
+        openCheckpointFile();
+    }
+
+    phaseTimes[PHASE_IO] += MPI_Wtime() - wtime;
+
+    // time steps, after a restart from the step of the checkpoint
+    for (int i = restartStep + 1; i < tPoints; ++i)
+    {
+        simulateOneTimeStep();
+
+        start = MPI_Wtime();
+
+        if (outputFile[0] != '\0' && snapshotInterval > 0 && i % snapshotInterval == 0)
+        {
+            writeWave();
+        }
+
+        if (checkpointInterval > 0)
+        {
+
+            if (i % checkpointInterval == 0)
+            {
+                startCheckpoint(i);
+            }
+            else if (checkpointStep >= 0)
+            {
+                // let the MPI library progress the writes
+                int done;
+                CHECK(MPI_Testall(2, checkpointRequests, &done, MPI_STATUSES_IGNORE));
+            }
+        }
+
+        phaseTimes[PHASE_IO] += MPI_Wtime() - start;
+    }
+
+    start = MPI_Wtime();
+
+    if (checkpointInterval > 0)
+    {
+        closeCheckpointFile();
+    }
+
+    // the final state, unless it is the last snapshot already
+    if (outputFile[0] != '\0')
+    {
+
+        if (snapshotInterval == 0 || tPoints < 2 || (tPoints - 1) % snapshotInterval != 0)
+        {
+            writeWave();
+        }
+        closeOutputFile();
+    }
+
+    phaseTimes[PHASE_IO] += MPI_Wtime() - start;
+    start = MPI_Wtime();
+
+    if (streamChunk > 0)
+    {
+        // the values are printed while they arrive
+        streamWave();
+        elapsed = MPI_Wtime() - wtime;
+    }
+    else
+    {
+        collectWave();
+        elapsed = MPI_Wtime() - wtime;
+
+        if (id == FIRST && printvalues)
+        {
+            outputNew();
+        }
+    }
+
+    phaseTimes[PHASE_COLLECT] += wtime + elapsed - start;
+
+    return elapsed;
+}
+
+void collectWave()
+{
+
+    // the master can read the whole wave directly, it starts with its own points
+    if (sharedMemoryActive)
+    {
+
+        if (id == FIRST)
+        {
+            globalStep = currentStep;
+        }
+        return;
+    }
+
+    // every process sends only its own points, the ghost points may be outdated between two halo exchanges
+    CHECK(MPI_Gatherv(&currentStep[ghostsLeft], ownedPoints, MPI_DOUBLE, globalStep, recvCounts, displacements, MPI_DOUBLE, FIRST, waveComm));
+}
+
+void streamWave()
+{
+
+    int count;
+
+    // if Master, recieve the points of every process in order, one chunk at a time
+    if (id == FIRST)
+    {
+
+        if (printvalues)
+        {
+            printf("####Current Values:####\n");
+            for (int l = 0; l < ownedPoints; ++l)
+            {
+                printf("%4d => %6.6f\n", l, currentStep[l]);
+            }
+        }
+
+        for (int i = 1; i < numberOfProcesses; i++)
+        {
+            for (int start = 0; start < recvCounts[i]; start += streamChunk)
+            {
+
+                count = (recvCounts[i] - start < streamChunk) ? recvCounts[i] - start : streamChunk;
+                CHECK(MPI_Recv(streamBuffer, count, MPI_DOUBLE, i, ACTUAL, waveComm, MPI_STATUS_IGNORE));
+
+                if (printvalues)
+                {
+                    for (int l = 0; l < count; ++l)
+                    {
+                        printf("%4d => %6.6f\n", displacements[i] + start + l, streamBuffer[l]);
+                    }
+                }
+            }
+        }
+    }
+    else
+    { // if not master, send own points to master
+
+        for (int start = 0; start < ownedPoints; start += streamChunk)
+        {
+            count = (ownedPoints - start < streamChunk) ? ownedPoints - start : streamChunk;
+            CHECK(MPI_Send(&currentStep[ghostsLeft + start], count, MPI_DOUBLE, FIRST, ACTUAL, waveComm));
+        }
+    }
+}
 
-    if (numberofargc > 1)
+void startFrame(int columns)
+{
+
+    // the columns of the own points, the first and the last one may be shared with the neighbors
+    const int firstColumn = (int) ((long) displacements[id] * columns / nPointsGlobal);
+    const int lastColumn = (int) ((long) (displacements[id] + ownedPoints - 1) * columns / nPointsGlobal);
+    const int count = lastColumn + 1 - firstColumn;
+
+    if (2 * count > frameCapacity)
     {
-        getFromCmdLine(numberofargc, argv);
+        frameCapacity = 2 * count;
+        frameBuffer = (double *) realloc(frameBuffer, frameCapacity * sizeof(double));
     }
-    else
+
+    // the first own point and the one after the last, relative to the global line
+    const int ownFrom = displacements[id];
+    const int ownTo = displacements[id] + ownedPoints;
+    int c;
+
+    // the columns are independent, the threads of this process share them
+    #pragma omp parallel for if(ownedPoints >= MIN_POINTS_PER_THREAD) shared(frameBuffer, currentStep, columns, firstColumn, count) private(c)
+    for (c = 0; c < count; c++)
+    {
+
+        // point g is in column g * columns / nPointsGlobal, only the own points of the column count
+        const int column = firstColumn + c;
+        const int start = (int) (((long) column * nPointsGlobal + columns - 1) / columns);
+        const int end = (int) (((long) (column + 1) * nPointsGlobal + columns - 1) / columns);
+        const int from = ghostsLeft + ((start > ownFrom) ? start : ownFrom) - ownFrom;
+        const int to = ghostsLeft + ((end < ownTo) ? end : ownTo) - ownFrom;
+
+        double lo = currentStep[from];
+        double hi = currentStep[from];
+
+        // the compiler turns this into vector min/max instructions
+        #pragma omp simd reduction(min : lo) reduction(max : hi)
+        for (int i = from + 1; i < to; i++)
+        {
+            lo = (currentStep[i] < lo) ? currentStep[i] : lo;
+            hi = (currentStep[i] > hi) ? currentStep[i] : hi;
+        }
+
+        frameBuffer[2 * c] = lo;
+        frameBuffer[2 * c + 1] = hi;
+    }
+
+    // the master knows the layout of all processes, the counts stay valid even if the slabs are rebalanced meanwhile
+    if (id == FIRST)
+    {
+
+        if (frameCounts == NULL)
+        {
+            frameCounts = (int *) malloc(numberOfProcesses * sizeof(int));
+            frameDisplacements = (int *) malloc(numberOfProcesses * sizeof(int));
+            frameFirstColumns = (int *) malloc(numberOfProcesses * sizeof(int));
+        }
+
+        int total = 0;
+
+        for (int i = 0; i < numberOfProcesses; i++)
+        {
+            const int first = (int) ((long) displacements[i] * columns / nPointsGlobal);
+            const int last = (int) ((long) (displacements[i] + recvCounts[i] - 1) * columns / nPointsGlobal);
+
+            frameFirstColumns[i] = first;
+            frameCounts[i] = 2 * (last + 1 - first);
+            frameDisplacements[i] = total;
+            total += frameCounts[i];
+        }
+
+        if (total > gatheredCapacity)
+        {
+            gatheredCapacity = total;
+            frameGathered = (double *) realloc(frameGathered, gatheredCapacity * sizeof(double));
+        }
+
+        if (columns != frameColumns)
+        {
+            frame = (double *) realloc(frame, 2 * columns * sizeof(double));
+        }
+    }
+
+    frameColumns = columns;
+
+    CHECK(MPI_Igatherv(frameBuffer, 2 * count, MPI_DOUBLE, frameGathered, frameCounts, frameDisplacements, MPI_DOUBLE, FIRST, waveComm, &frameRequest));
+
+    // the differences across the borders to the neighbors are left out, the ghost points may be outdated
+    const int first = ghostsLeft;
+    const int last = ghostsLeft + ownedPoints - 1;
+    double kinetic = 0.0, potential = 0.0;
+    int i;
+
+    #pragma omp parallel for if(ownedPoints >= MIN_POINTS_PER_THREAD) shared(currentStep, previousStep) private(i) reduction(+ : kinetic, potential)
+    for (i = first; i <= last; i++)
     {
-        // no cmd args, use default settings file
-        getFromSettingsFile(DEFAULT_SETTINGS_FILE_PATH);
+        kinetic += (currentStep[i] - previousStep[i]) * (currentStep[i] - previousStep[i]);
+
+        if (i < last)
+        {
+            potential += (currentStep[i + 1] - currentStep[i]) * (currentStep[i + 1] - currentStep[i]);
+        }
     }
 
-    // check values for validity
-    checkParams();
+    localEnergy = 0.5 * (kinetic + cSquared * potential);
+
+    CHECK(MPI_Ireduce(&localEnergy, &frameEnergy, 1, MPI_DOUBLE, MPI_SUM, FIRST, waveComm, &energyRequest));
 }
 
-double waveInitFunc(double x)
+int testFrame()
 {
-    // divide by (intervalEnd - 1) to satisfy the right border condition
-    // necessary because 1000 points means indices 0 to 999
-    return (amplitude * sin(2 * x * M_PI * periods / (intervalEnd - 1)));
+
+    int done = 1;
+
+    if (frameRequest != MPI_REQUEST_NULL)
+    {
+        CHECK(MPI_Test(&frameRequest, &done, MPI_STATUS_IGNORE));
+    }
+
+    if (energyRequest != MPI_REQUEST_NULL)
+    {
+        int energyDone;
+
+        CHECK(MPI_Test(&energyRequest, &energyDone, MPI_STATUS_IGNORE));
+        done = done && energyDone;
+    }
+
+    return done;
 }
 
-void initWaveConditions()
+void finishFrame()
 {
-    // calculate left and right border for every process
-    left = (id * (nPointsGlobal - 1)) / numberOfProcesses;
-    right = ((id + 1) * (nPointsGlobal - 1)) / numberOfProcesses;
+
+    CHECK(MPI_Wait(&frameRequest, MPI_STATUS_IGNORE));
+    CHECK(MPI_Wait(&energyRequest, MPI_STATUS_IGNORE));
 
     if (id != FIRST)
     {
-        left = left - 1;
+        return;
     }
-    nPointsLocal = right + 1 - left;
 
-    // allocate space for local arrays
-    const size_t bufSize = nPointsLocal * sizeof(double);
-    previousStep = (double *) malloc(bufSize);
-    currentStep = (double *) malloc(bufSize);
-    nextStep = (double *) malloc(bufSize);
+    for (int c = 0; c < frameColumns; c++)
+    {
+        frame[2 * c] = DBL_MAX;
+        frame[2 * c + 1] = -DBL_MAX;
+    }
 
-    // master needs another global array to collect everything in the end
-    if (id == FIRST)
+    // the pairs of all processes are in order, only the columns at the borders appear twice
+    for (int i = 0; i < numberOfProcesses; i++)
     {
-        globalStep = (double *) malloc(nPointsGlobal * sizeof(double));
+
+        const double *pairs = &frameGathered[frameDisplacements[i]];
+
+        for (int k = 0; k < frameCounts[i] / 2; k++)
+        {
+
+            const int c = frameFirstColumns[i] + k;
+
+            frame[2 * c] = (pairs[2 * k] < frame[2 * c]) ? pairs[2 * k] : frame[2 * c];
+            frame[2 * c + 1] = (pairs[2 * k + 1] > frame[2 * c + 1]) ? pairs[2 * k + 1] : frame[2 * c + 1];
+        }
     }
+}
 
-    resetWave();
+double *getFrame()
+{
+    return frame;
 }
 
-void simulateOneTimeStep()
+double getFrameEnergy()
 {
+    return frameEnergy;
+}
 
-    int i;
+void openOutputFile()
+{
+
+    MPI_Info hints;
 
-    // calculate next time step with wave equation
-    for (i = 1; i < right - left; i++)
+    // let a few processes gather the slabs into large contiguous writes
+    CHECK(MPI_Info_create(&hints));
+    CHECK(MPI_Info_set(hints, "romio_cb_write", "enable"));
+    CHECK(MPI_Info_set(hints, "cb_buffer_size", "16777216"));
+
+    if (MPI_SUCCESS != MPI_File_open(waveComm, outputFile, MPI_MODE_CREATE | MPI_MODE_WRONLY, hints, &outputHandle))
     {
-        nextStep[i] = 2.0 * currentStep[i] - previousStep[i] + cSquared * (currentStep[i - 1] - (2.0 * currentStep[i]) + currentStep[i + 1]);
+        if (id == FIRST)
+        {
+            printf("[ERROR] Could not open file '%s'!\n", outputFile);
+        }
+        MPI_Finalize();
+        exit(EXIT_FAILURE);
     }
+    CHECK(MPI_Info_free(&hints));
 
-    if (id != FIRST)
+    // overwrite the results of earlier runs
+    CHECK(MPI_File_set_size(outputHandle, 0));
+    framesWritten = 0;
+}
+
+void writeWave()
+{
+
+    // every frame holds all points, every process writes its own points at their global position
+    const MPI_Offset offset = ((MPI_Offset) framesWritten * nPointsGlobal + left + ghostsLeft) * sizeof(double);
+
+    CHECK(MPI_File_write_at_all(outputHandle, offset, &currentStep[ghostsLeft], ownedPoints, MPI_DOUBLE, MPI_STATUS_IGNORE));
+    framesWritten++;
+}
+
+void closeOutputFile()
+{
+
+    CHECK(MPI_File_close(&outputHandle));
+
+    if (id == FIRST)
+    {
+        printf("Wrote %d frame%s of %d points to '%s'\n", framesWritten, framesWritten == 1 ? "" : "s", nPointsGlobal, outputFile);
+    }
+}
+
+void freeHaloExchange()
+{
+
+    free(sendLeft);
+    free(sendRight);
+
+    if (haloMode == HALO_RMA)
     {
-        // exchange border values with the left neighbor
-        CHECK(MPI_Send(&nextStep[1], 1, MPI_DOUBLE, id - 1, R_TO_L, MPI_COMM_WORLD));
-        CHECK(MPI_Recv(&nextStep[0], 1, MPI_DOUBLE, id - 1, L_TO_R, MPI_COMM_WORLD, &status));
+        CHECK(MPI_Win_free(&haloWindow));
+        CHECK(MPI_Group_free(&neighborGroup));
     }
     else
     {
-        // FIRST is the "leftmost" process and has no left neighbor but the boundary condition
-        nextStep[0] = 0.0;
+        free(recvLeft);
+        free(recvRight);
     }
 
-    if (id != LAST)
+    if (haloMode == HALO_PERSISTENT)
     {
-        // exchange border values with the right neighbor
-        CHECK(MPI_Send(&nextStep[right - left - 1], 1, MPI_DOUBLE, id + 1, L_TO_R, MPI_COMM_WORLD));
-        CHECK(MPI_Recv(&nextStep[right - left], 1, MPI_DOUBLE, id + 1, R_TO_L, MPI_COMM_WORLD, &status));
+        for (int i = 0; i < 4; i++)
+        {
+            CHECK(MPI_Request_free(&haloRequests[i]));
+        }
     }
-    else
+}
+
+void openCheckpointFile()
+{
+
+    if (MPI_SUCCESS != MPI_File_open(waveComm, checkpointFile, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &checkpointHandle))
     {
-        // LAST is the "rightmost" and has no right neighbor but the boundary condition
-        nextStep[right - left] = 0.0;
+        if (id == FIRST)
+        {
+            printf("[ERROR] Could not open file '%s'!\n", checkpointFile);
+        }
+        MPI_Finalize();
+        exit(EXIT_FAILURE);
     }
 
-    // copy values one step "into the past"
-    double *tempStep = previousStep;
-    previousStep = currentStep;
-    currentStep = nextStep;
-    nextStep = tempStep;
+    // previous and current step of all points
+    checkpointBuffer = (double *) malloc(2 * ownedPoints * sizeof(double));
+    checkpointStep = -1;
 }
 
-double simulateNumberOfTimeSteps()
+void startCheckpoint(int step)
 {
 
-    double elapsed, wtime = MPI_Wtime();
+    // the buffer is still needed by the last checkpoint
+    finishCheckpoint();
 
-    // time steps
-    for (int i = 1; i < tPoints; ++i)
+    // the points may have moved since the last checkpoint
+    if (rebalanceInterval > 0)
     {
-        simulateOneTimeStep();
+        checkpointBuffer = (double *) realloc(checkpointBuffer, 2 * ownedPoints * sizeof(double));
     }
-    collectWave();
 
-    elapsed = MPI_Wtime() - wtime;
-
-    if (id == FIRST && printvalues)
+    // mark the file as incomplete until all processes are done
+    if (id == FIRST)
     {
-        outputNew();
+        writeCheckpointHeader(-1);
     }
 
-    return elapsed;
+    // the time step arrays change in the next steps, so the points are copied first
+    memcpy(checkpointBuffer, &previousStep[ghostsLeft], ownedPoints * sizeof(double));
+    memcpy(&checkpointBuffer[ownedPoints], &currentStep[ghostsLeft], ownedPoints * sizeof(double));
+
+    // the file is indexed by the global point, so it does not depend on the number of processes
+    const MPI_Offset previousOffset = sizeof(CheckpointHeader) + (MPI_Offset) (left + ghostsLeft) * sizeof(double);
+    const MPI_Offset currentOffset = previousOffset + (MPI_Offset) nPointsGlobal * sizeof(double);
+
+    CHECK(MPI_File_iwrite_at_all(checkpointHandle, previousOffset, checkpointBuffer, ownedPoints, MPI_DOUBLE, &checkpointRequests[0]));
+    CHECK(MPI_File_iwrite_at_all(checkpointHandle, currentOffset, &checkpointBuffer[ownedPoints], ownedPoints, MPI_DOUBLE, &checkpointRequests[1]));
+
+    checkpointStep = step;
 }
 
-void collectWave()
+void finishCheckpoint()
 {
 
-    // if Master, collect all others
+    if (checkpointStep < 0)
+    {
+        return;
+    }
+
+    CHECK(MPI_Waitall(2, checkpointRequests, MPI_STATUSES_IGNORE));
+
+    // all points are in the file before the header marks it as complete
+    CHECK(MPI_File_sync(checkpointHandle));
+
     if (id == FIRST)
     {
+        writeCheckpointHeader(checkpointStep);
+        printf("[INFO] Checkpoint of step %d written to '%s'\n", checkpointStep, checkpointFile);
+    }
+
+    checkpointStep = -1;
+}
+
+void writeCheckpointHeader(int step)
+{
+
+    CheckpointHeader header;
+
+    memset(&header, 0, sizeof(CheckpointHeader));
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.nPoints = nPointsGlobal;
+    header.step = step;
+
+    CHECK(MPI_File_write_at(checkpointHandle, 0, &header, sizeof(CheckpointHeader), MPI_BYTE, MPI_STATUS_IGNORE));
+}
+
+void closeCheckpointFile()
+{
+
+    finishCheckpoint();
+
+    CHECK(MPI_File_close(&checkpointHandle));
+    free(checkpointBuffer);
+}
 
-        // write own results to global array first
-        for (int i = 0; i <= right; i++)
+void readCheckpoint()
+{
+
+    MPI_File restartHandle;
+    CheckpointHeader header;
+
+    if (MPI_SUCCESS != MPI_File_open(waveComm, restartFile, MPI_MODE_RDONLY, MPI_INFO_NULL, &restartHandle))
+    {
+        if (id == FIRST)
         {
-            globalStep[i] = currentStep[i];
+            printf("[ERROR] Could not get file '%s'!\n", restartFile);
         }
+        MPI_Finalize();
+        exit(EXIT_FAILURE);
+    }
 
-        int startIdx, cnt = 0;
+    CHECK(MPI_File_read_at_all(restartHandle, 0, &header, sizeof(CheckpointHeader), MPI_BYTE, MPI_STATUS_IGNORE));
 
-        // recieve results from every other process and write it
-        for (int i = 1; i < numberOfProcesses; i++)
+    // all processes read the same header, so they all stop here together
+    if (0 != memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) || header.nPoints != nPointsGlobal || header.step < 0)
+    {
+        if (id == FIRST)
         {
+            printf("[ERROR] '%s' is no complete checkpoint with %d points!\n", restartFile, nPointsGlobal);
+        }
+        MPI_Finalize();
+        exit(EXIT_FAILURE);
+    }
 
-            // recieve info about the coming data
-            CHECK(MPI_Recv(buffer, 2, MPI_INT, i, INFO, MPI_COMM_WORLD, &status));
+    // the own points and ghost points of the current layout, with shared memory only the own points
+    const int from = sharedMemoryActive ? ghostsLeft : 0;
+    const int count = sharedMemoryActive ? ownedPoints : nPointsLocal;
+    const MPI_Offset previousOffset = sizeof(CheckpointHeader) + (MPI_Offset) (left + from) * sizeof(double);
+    const MPI_Offset currentOffset = previousOffset + (MPI_Offset) nPointsGlobal * sizeof(double);
 
-            startIdx = buffer[0]; // start index in global array
-            cnt = buffer[1];      // how many points to expect
+    CHECK(MPI_File_read_at_all(restartHandle, previousOffset, &previousStep[from], count, MPI_DOUBLE, MPI_STATUS_IGNORE));
+    CHECK(MPI_File_read_at_all(restartHandle, currentOffset, &currentStep[from], count, MPI_DOUBLE, MPI_STATUS_IGNORE));
+    CHECK(MPI_File_close(&restartHandle));
 
-            // recieve <count> values and write them into the global array, starting at index <left>
-            CHECK(MPI_Recv(&globalStep[startIdx], cnt, MPI_DOUBLE, i, ACTUAL, MPI_COMM_WORLD, &status));
-        }
-        //outputNew();
+    if (sharedMemoryActive)
+    {
+        syncSharedSteps();
     }
-    else
-    { // if not master, send to master
 
-        buffer[0] = left;         // start index in global array
-        buffer[1] = nPointsLocal; // how many points to expect
+    restartStep = header.step;
+    stepsDone = header.step;
 
-        // first send info about the data...
-        CHECK(MPI_Send(buffer, 2, MPI_INT, 0, INFO, MPI_COMM_WORLD));
-
-        // ...then send the actual values
-        CHECK(MPI_Send(currentStep, nPointsLocal, MPI_DOUBLE, 0, ACTUAL, MPI_COMM_WORLD));
+    if (id == FIRST)
+    {
+        printf("Restarting from step %d of '%s'\n", restartStep, restartFile);
     }
 }
 
@@ -621,11 +1987,43 @@ void finalizeWave()
 
     if (id == FIRST)
     {
-        free(globalStep);
+        free(streamBuffer);
+    }
+    free(recvCounts);
+    free(displacements);
+
+    // frames of the visualisation
+    free(frameBuffer);
+    free(frameGathered);
+    free(frame);
+    free(frameCounts);
+    free(frameDisplacements);
+    free(frameFirstColumns);
+
+    if (sharedMemoryActive)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            CHECK(MPI_Win_unlock_all(stepWindows[i]));
+            CHECK(MPI_Win_free(&stepWindows[i]));
+        }
+    }
+    else
+    {
+
+        if (id == FIRST)
+        {
+            free(globalStep);
+        }
+        free(currentStep);
+        free(previousStep);
+        free(nextStep);
+
+        freeHaloExchange();
     }
-    free(currentStep);
-    free(previousStep);
-    free(nextStep);
+
+    CHECK(MPI_Comm_free(&nodeComm));
+    CHECK(MPI_Comm_free(&waveComm));
 
     // exit mpi
     MPI_Finalize();
@@ -634,22 +2032,46 @@ void finalizeWave()
 void resetWave()
 {
 
-    memset(previousStep, 0, nPointsLocal);
-    memset(currentStep, 0, nPointsLocal);
-    memset(nextStep, 0, nPointsLocal);
+    // with shared memory, every process only touches its own points, once the master is done reading them
+    const int from = sharedMemoryActive ? ghostsLeft : 0;
+    const int to = sharedMemoryActive ? nPointsLocal - ghostsRight : nPointsLocal;
 
-    if (id == FIRST)
+    if (sharedMemoryActive)
+    {
+        syncSharedSteps();
+    }
+    else
     {
-        memset(globalStep, 0, nPointsGlobal);
+
+        memset(previousStep, 0, nPointsLocal);
+        memset(currentStep, 0, nPointsLocal);
+        memset(nextStep, 0, nPointsLocal);
+
+        if (id == FIRST && streamChunk == 0)
+        {
+            memset(globalStep, 0, nPointsGlobal);
+        }
     }
 
+    // the ghost points are valid again
+    stepInBlock = 0;
+    restartStep = 0;
+    stepsDone = 0;
+    stepsSinceRebalance = 0;
+    computeTime = 0.0;
+
     // initialize the first time step
-    for (int k = 0; k < nPointsLocal; k++)
+    for (int k = from; k < to; k++)
     {
         double x = (k + left) * deltaX;
         previousStep[k] = waveInitFunc(x);
         currentStep[k] = waveInitFunc(x);
     }
+
+    if (sharedMemoryActive)
+    {
+        syncSharedSteps();
+    }
 }
 
 void outputNew()
@@ -673,13 +2095,17 @@ void performBenchmark()
 
     double mean = 0.0;
     double stddev = 0.0;
+    double wallTime = 0.0;
 
     initWaveConditions();
 
+    memset(phaseTimes, 0, sizeof(phaseTimes));
+
     // run repeatedly
     for (int i = 0; i < RERUNS; i++)
     {
         double etime = simulateNumberOfTimeSteps();
+        wallTime += etime;
 
         if (id == FIRST)
         {
@@ -697,7 +2123,7 @@ void performBenchmark()
         if (NULL == fp)
         {
             printf("[ERROR] Could not get file '%s'!\n", BENCHMARK_FILE);
-            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+            MPI_Abort(waveComm, EXIT_FAILURE);
             exit(EXIT_FAILURE);
         }
 
@@ -717,13 +2143,97 @@ void performBenchmark()
 
         printf("Finished! Mean: %10.8f (Stddev:%10.8f)\n", mean, stddev);
 
-        fprintf(fp, "Running for %5d timesteps with %10d points took %10.8f seconds with stddev = %10.8f after %2d reruns.\n", tPoints, nPointsGlobal, mean, stddev, RERUNS);
+        fprintf(fp, "Running for %5d timesteps with %10d points, ghost depth %3d and halo mode %d took %10.8f seconds with stddev = %10.8f after %2d reruns.\n", tPoints, nPointsGlobal, ghostDepth, haloMode, mean, stddev, RERUNS);
         fclose(fp);
     }
 
+    // where the time went on every process
+    FILE *phasesFp = NULL;
+
+    if (id == FIRST)
+    {
+
+        phasesFp = fopen(PHASES_FILE, "a");
+
+        if (NULL == phasesFp)
+        {
+            printf("[ERROR] Could not get file '%s'!\n", PHASES_FILE);
+            MPI_Abort(waveComm, EXIT_FAILURE);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    reportPhaseTimes(wallTime, RERUNS, phasesFp);
+
+    if (id == FIRST)
+    {
+        fclose(phasesFp);
+    }
+
     finalizeWave();
 }
 
+void reportPhaseTimes(double wallTime, int runs, FILE *fp)
+{
+
+    double minTimes[NUMBER_OF_PHASES], maxTimes[NUMBER_OF_PHASES], sumTimes[NUMBER_OF_PHASES];
+    double maxWallTime;
+
+    // the busy time of a process is everything except waiting for the others
+    struct
+    {
+        double time;
+        int rank;
+    } busy, busiest;
+
+    busy.time = 0.0;
+    busy.rank = id;
+
+    for (int p = 0; p < NUMBER_OF_PHASES; p++)
+    {
+
+        if (p != PHASE_WAIT)
+        {
+            busy.time += phaseTimes[p];
+        }
+    }
+
+    CHECK(MPI_Reduce(phaseTimes, minTimes, NUMBER_OF_PHASES, MPI_DOUBLE, MPI_MIN, FIRST, waveComm));
+    CHECK(MPI_Reduce(phaseTimes, maxTimes, NUMBER_OF_PHASES, MPI_DOUBLE, MPI_MAX, FIRST, waveComm));
+    CHECK(MPI_Reduce(phaseTimes, sumTimes, NUMBER_OF_PHASES, MPI_DOUBLE, MPI_SUM, FIRST, waveComm));
+    CHECK(MPI_Reduce(&wallTime, &maxWallTime, 1, MPI_DOUBLE, MPI_MAX, FIRST, waveComm));
+    CHECK(MPI_Reduce(&busy, &busiest, 1, MPI_DOUBLE_INT, MPI_MAXLOC, FIRST, waveComm));
+
+    if (id != FIRST)
+    {
+        return;
+    }
+
+    // the same table on the console and in the file, all times per run
+    FILE *outputs[2] = {stdout, fp};
+
+    for (int o = 0; o < 2; o++)
+    {
+
+        fprintf(outputs[o], "Phase times per run for %5d timesteps with %10d points on %3d processes, ghost depth %3d and halo mode %d:\n",
+                tPoints, nPointsGlobal, numberOfProcesses, ghostDepth, haloMode);
+        fprintf(outputs[o], "%-10s %14s %14s %14s %9s\n", "phase", "min", "mean", "max", "max/mean");
+
+        for (int p = 0; p < NUMBER_OF_PHASES; p++)
+        {
+
+            const double mean = sumTimes[p] / numberOfProcesses / runs;
+            const double imbalance = (mean > 0.0) ? maxTimes[p] / runs / mean : 1.0;
+
+            fprintf(outputs[o], "%-10s %14.8f %14.8f %14.8f %9.3f\n", phaseNames[p], minTimes[p] / runs, mean, maxTimes[p] / runs, imbalance);
+        }
+
+        // nothing can finish before the busiest process, the rest of the wall time is spent waiting on the slowest link
+        fprintf(outputs[o], "Critical path estimate: process %d is busy for %10.8f of %10.8f seconds (%5.1f%%).\n\n",
+                busiest.rank, busiest.time / runs, maxWallTime / runs, (maxWallTime > 0.0) ? 100.0 * busiest.time / maxWallTime : 0.0);
+    }
+}
+
 double *getStep()
 {
     return globalStep;
@@ -753,3 +2263,13 @@ int doBench()
 {
     return doBenchmark;
 }
+
+int getRank()
+{
+    return id;
+}
+
+MPI_Comm getComm()
+{
+    return waveComm;
+}
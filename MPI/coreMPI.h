@@ -14,8 +14,10 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <float.h>
 
 #include <mpi.h>
+#include <omp.h>
 
 /**
  * @def _USE_MATH_DEFINES
@@ -53,6 +55,164 @@
  */
 #define BENCHMARK_FILE "../benchmark/benchResults.txt"
 
+/**
+ * @def PHASES_FILE
+ * 
+ * The output file for the time every process spent in each phase of a benchmark
+ */
+#define PHASES_FILE "../benchmark/phaseResults.txt"
+
+/**
+ * @def MAX_PATH_LENGTH
+ * 
+ * Represents the maximum length of a file path
+ */
+#define MAX_PATH_LENGTH 256
+
+/**
+ * @def HALO_MESSAGES
+ * 
+ * Halo exchange mode: new non-blocking messages for every exchange
+ */
+#define HALO_MESSAGES 0
+
+/**
+ * @def HALO_PERSISTENT
+ * 
+ * Halo exchange mode: persistent requests, set up once and restarted for every exchange
+ */
+#define HALO_PERSISTENT 1
+
+/**
+ * @def HALO_RMA
+ * 
+ * Halo exchange mode: one-sided @c MPI_Put into a window of the neighbors, synchronized with post/start/complete/wait
+ */
+#define HALO_RMA 2
+
+/**
+ * @def REBALANCE_THRESHOLD
+ * 
+ * Points are only moved if the slowest process needs this much more time than the fastest (0.05 = 5%)
+ */
+#define REBALANCE_THRESHOLD 0.05
+
+/**
+ * @def SETTINGS_VALID
+ * 
+ * Status of the broadcast settings if all processes can start, otherwise the status is the exit code
+ */
+#define SETTINGS_VALID -1
+
+/**
+ * @def DEFAULT_CHECKPOINT_FILE
+ * 
+ * The default file for checkpoints
+ */
+#define DEFAULT_CHECKPOINT_FILE "checkpoint.bin"
+
+/**
+ * @def CHECKPOINT_MAGIC
+ * 
+ * Identifies checkpoint files, stored in their header
+ */
+#define CHECKPOINT_MAGIC "WAVECKPT"
+
+/**
+ * @def MIN_POINTS_PER_THREAD
+ * 
+ * Ranges with fewer points than this are calculated without starting the OpenMP threads
+ */
+#define MIN_POINTS_PER_THREAD 1000
+
+/**
+ * @def PHASE_COMPUTE
+ * 
+ * Phase timer: calculating the points
+ */
+#define PHASE_COMPUTE 0
+
+/**
+ * @def PHASE_HALO
+ * 
+ * Phase timer: packing, sending and unpacking the halos
+ */
+#define PHASE_HALO 1
+
+/**
+ * @def PHASE_WAIT
+ * 
+ * Phase timer: waiting for the halos or the other processes on the node
+ */
+#define PHASE_WAIT 2
+
+/**
+ * @def PHASE_REBALANCE
+ * 
+ * Phase timer: rebalancing the slabs
+ */
+#define PHASE_REBALANCE 3
+
+/**
+ * @def PHASE_COLLECT
+ * 
+ * Phase timer: collecting or streaming the wave to the master
+ */
+#define PHASE_COLLECT 4
+
+/**
+ * @def PHASE_IO
+ * 
+ * Phase timer: writing output frames and checkpoints
+ */
+#define PHASE_IO 5
+
+/**
+ * @def NUMBER_OF_PHASES
+ * 
+ * Number of phase timers
+ */
+#define NUMBER_OF_PHASES 6
+
+/**
+ * @brief All settings the master sends to the other processes
+ */
+typedef struct
+{
+    double waveSpeed;                /**< speed of the wave */
+    double lambda;                   /**< damping factor */
+    int intervalEnd;                 /**< right border of the line interval */
+    int nPointsGlobal;               /**< number of points on the line */
+    int tPoints;                     /**< number of time steps, 0 loops forever */
+    int periods;                     /**< number of periods of the sine wave */
+    int amplitude;                   /**< amplitude of the sine wave */
+    int useGui;                      /**< show the visualization */
+    int printvalues;                 /**< print the values to console */
+    int doBenchmark;                 /**< run a benchmark */
+    int threadsPerRank;              /**< OpenMP threads per process, 0 for OMP_NUM_THREADS or 1 */
+    int ghostDepth;                  /**< ghost points per side */
+    int haloMode;                    /**< how the halos are exchanged */
+    int useSharedMemory;             /**< share the wave if all processes run on one node */
+    int rebalanceInterval;           /**< steps between two rebalancings, 0 disables it */
+    int streamChunk;                 /**< chunk size for streaming, 0 disables it */
+    int snapshotInterval;            /**< steps between two snapshots, 0 writes only the final state */
+    int status;                      /**< @c SETTINGS_VALID or the exit code for all processes */
+    int checkpointInterval;          /**< steps between two checkpoints, 0 disables them */
+    char outputFile[MAX_PATH_LENGTH]; /**< binary output file, empty if disabled */
+    char checkpointFile[MAX_PATH_LENGTH]; /**< file for the checkpoints */
+    char restartFile[MAX_PATH_LENGTH]; /**< checkpoint to continue from, empty if disabled */
+} WaveSettings;
+
+/**
+ * @brief Header of a checkpoint file, followed by the previous and the current step of all points
+ */
+typedef struct
+{
+    char magic[8]; /**< @c CHECKPOINT_MAGIC without the terminating zero */
+    int nPoints;   /**< number of points on the line */
+    int step;      /**< time step of the checkpoint, -1 while it is written */
+} CheckpointHeader;
+
 
 /**
   * @brief Checks a given MPI return code for errors
@@ -82,19 +242,54 @@ void getFromSettingsFile(char *configPath);
 void getFromCmdLine(int nargc, char** argv);
 
 /**
-  * @brief Checks all parameters for validity
+  * @brief Reads the options from the command line, starting at the given argument
+  * @param nargc argument count of the program
+  * @param argv arguments of the program
+  * @param first index of the first option in @p argv
+  */
+void getOptionsFromCmdLine(int nargc, char** argv, int first);
+
+/**
+  * @brief Checks all parameters for validity, only called by the master
   */
 void checkParams(void);
 
+/**
+  * @brief Sends the settings of the master to all other processes
+  *
+  * All processes exit if @p status is not @c SETTINGS_VALID.
+  *
+  * @param status @c SETTINGS_VALID or the exit code
+  */
+void broadcastSettings(int status);
+
+/**
+  * @brief Lets all processes exit while the master is reading the settings
+  *
+  * @param exitCode The exit code of all processes
+  */
+void stopAllProcesses(int exitCode);
+
+/**
+  * @brief Calculates the values derived from the settings on every process
+  */
+void applySettings(void);
+
+/**
+  * @brief Prints how the processes and threads are distributed over the nodes
+  */
+void outputLayout(void);
+
 /**
   * @brief Reads the given cmd arguments
   *
+  * Also arranges the processes as a line in a cartesian communicator, see @c getComm().
+  *
   * @param numberofargc argument count of the program
   * @param argv arguments of the program
-  * @param pid ID of the mpi process
   * @param pnum number of mpi processes
   */
-void getUserInputOrConfig(int numberofargc, char** argv, int pid, int pnum);
+void getUserInputOrConfig(int numberofargc, char** argv, int pnum);
 
 /**
   * @brief Calculates the initial sine wave values 
@@ -109,11 +304,101 @@ double waveInitFunc(double x);
   */
 void initWaveConditions(void);
 
+/**
+  * @brief Calculates the next time step for the local points in [@c from, @c to)
+  *
+  * @param from First local index to calculate
+  * @param to Local index after the last one to calculate
+  */
+void calculateRange(int from, int to);
+
+/**
+  * @brief Allocates the time step arrays as shared memory windows of all processes on the node
+  * 
+  * The own points of all processes form one contiguous line, so the local arrays
+  * including the ghost points are views into it.
+  */
+void allocateSharedSteps(void);
+
+/**
+  * @brief Makes the own points visible to all processes and waits for them
+  */
+void syncSharedSteps(void);
+
+/**
+  * @brief Allocates the halo buffers and sets up the requests or window for the halo exchange
+  */
+void initHaloExchange(void);
+
+/**
+  * @brief Frees everything set up by @c initHaloExchange()
+  */
+void freeHaloExchange(void);
+
+/**
+  * @brief Copies the points a neighbor needs as ghost points into a halo buffer
+  *
+  * @param halo Buffer with space for 2 * ghostDepth - 1 values
+  * @param start First local index of the points
+  * @param previousOffset 1 if the neighbor is on the right, 0 otherwise
+  */
+void packHalo(double *halo, int start, int previousOffset);
+
+/**
+  * @brief Copies a halo buffer received from a neighbor into the ghost points
+  *
+  * @param halo Buffer filled by @c packHalo()
+  * @param start First local index of the ghost points
+  * @param previousOffset 1 if the neighbor is on the left, 0 otherwise
+  */
+void unpackHalo(const double *halo, int start, int previousOffset);
+
+/**
+  * @brief Simulates the last time step before the ghost points run out and refreshes them
+  * 
+  * The edge points are calculated first and sent to the neighbors without blocking,
+  * the interior points are calculated while the messages are in flight.
+  *
+  * @param from First local index to calculate
+  * @param to Local index after the last one to calculate
+  */
+void exchangeHalos(int from, int to);
+
 /**
   * @brief Simulates one time step with the wave equation
+  * 
+  * Every process keeps ghostDepth ghost points per side, so the halos are only exchanged
+  * every ghostDepth steps. In between, the ghost points are updated redundantly.
   */
 void simulateOneTimeStep(void);
 
+/**
+  * @brief Moves points from slow to fast processes, based on the time spent calculating since the last call
+  */
+void rebalanceSlabs(void);
+
+/**
+  * @brief Calculates the new number of points for every process and logs the rebalancing
+  * 
+  * @param computeTimes Time spent calculating by every process
+  * @param newCounts Receives the new number of points of every process, unchanged if the imbalance is small
+  */
+void calculateNewCounts(const double *computeTimes, int *newCounts);
+
+/**
+  * @brief Moves the points to their new processes, including the ghost points
+  * 
+  * Only processes that exchange points send messages to each other, for small shifts these are the direct neighbors.
+  * 
+  * @param newCounts New number of points of every process
+  */
+void migratePoints(const int *newCounts);
+
+/**
+  * @brief Simulates one time step on the shared line, reading the neighbors' points directly
+  */
+void simulateSharedTimeStep(void);
+
 /**
   * @brief Calls @c simulateOneTimeStep() a specified number of times
   */
@@ -124,6 +409,110 @@ double simulateNumberOfTimeSteps(void);
   */
 void collectWave(void);
 
+/**
+  * @brief Sends the calculated values from all processes to the master in chunks
+  * 
+  * The master prints the values while they arrive and never holds the whole wave.
+  */
+void streamWave(void);
+
+/**
+  * @brief Starts sending a decimated frame of the wave to the master in the background
+  *
+  * Every process reduces its own points to the minimum and maximum per column, the columns
+  * at the borders between two processes are merged by the master in @c finishFrame().
+  * The energy of the wave is summed up on the master alongside.
+  * The process can continue calculating while the frame is on its way.
+  *
+  * @param columns the number of columns of the frame, at most the number of points
+  */
+void startFrame(int columns);
+
+/**
+  * @brief Lets the MPI library progress the frame, to be called between the time steps
+  *
+  * @return Whether the frame has arrived or was sent
+  */
+int testFrame(void);
+
+/**
+  * @brief Waits for the frame started with @c startFrame() and merges it on the master
+  */
+void finishFrame(void);
+
+/**
+  * @brief Returns the last finished frame on the master
+  *
+  * @return The minimum and maximum of every column, interleaved
+  */
+double *getFrame(void);
+
+/**
+  * @brief Returns the energy of the wave at the last finished frame on the master
+  *
+  * The differences between the last point of a process and the first point of its right
+  * neighbor are not part of the potential energy.
+  *
+  * @return The kinetic plus the potential energy, summed over all processes
+  */
+double getFrameEnergy(void);
+
+/**
+  * @brief Opens the shared output file for all processes and empties it
+  */
+void openOutputFile(void);
+
+/**
+  * @brief Appends the current time step as a frame of doubles to the output file
+  * 
+  * Every process writes its own points at their global position with one collective call.
+  */
+void writeWave(void);
+
+/**
+  * @brief Closes the shared output file
+  */
+void closeOutputFile(void);
+
+/**
+  * @brief Opens the checkpoint file for all processes
+  */
+void openCheckpointFile(void);
+
+/**
+  * @brief Starts writing a checkpoint of the current state in the background
+  *
+  * The writes overlap with the following time steps, they are finished by the next
+  * checkpoint or by @c closeCheckpointFile().
+  *
+  * @param step The time step of the current state
+  */
+void startCheckpoint(int step);
+
+/**
+  * @brief Waits for the running checkpoint and marks it as complete in the header
+  */
+void finishCheckpoint(void);
+
+/**
+  * @brief Writes the header of the checkpoint file, only called by the master
+  *
+  * @param step The time step of the checkpoint, -1 marks it as incomplete
+  */
+void writeCheckpointHeader(int step);
+
+/**
+  * @brief Finishes the last checkpoint and closes the checkpoint file
+  */
+void closeCheckpointFile(void);
+
+/**
+  * @brief Continues from the checkpoint in the restart file
+  *
+  * The file is indexed by global point, so it can be read with any number of processes.
+  */
+void readCheckpoint(void);
+
 /**
   * Frees the memory from the time step arrays
   */
@@ -144,6 +533,15 @@ void outputNew(void);
   */
 void performBenchmark(void);
 
+/**
+  * @brief Reduces the phase times of all processes to a min/mean/max table and a critical path estimate on the master
+  *
+  * @param wallTime the wall time of this process, summed over all runs
+  * @param runs the number of runs the times are summed over
+  * @param fp the file the master appends the table to
+  */
+void reportPhaseTimes(double wallTime, int runs, FILE *fp);
+
 /**
   * @brief Returns the current state of the wave values
   *
@@ -188,4 +586,18 @@ int showGui(void);
   */
 int doBench(void);
 
+/**
+  * @brief Returns the ID of this process in the communicator of @c getComm()
+  *
+  * @return The ID of this process, 0 is the master
+  */
+int getRank(void);
+
+/**
+  * @brief Returns the communicator of all processes, arranged as a line
+  *
+  * @return The cartesian communicator, the processes may be renumbered compared to MPI_COMM_WORLD
+  */
+MPI_Comm getComm(void);
+
 #endif //__CORE_MPI_H_
@@ -11,7 +11,7 @@
 
 const int MASTER = 0;
 
-int id, numberOfProcesses;
+static int id, numberOfProcesses;
 
 void initSdlVars(SDL_Window **win, SDL_Renderer **ren, TTF_Font **fon)
 {
@@ -99,12 +99,12 @@ void initSdlVars(SDL_Window **win, SDL_Renderer **ren, TTF_Font **fon)
 
     // set window icon
     SDL_SetWindowIcon(*win, icon);
+    SDL_FreeSurface(icon);
 }
 
-void closeSdlVars(SDL_Window **win, SDL_Renderer **ren, TTF_Font **fon, SDL_Surface **surf, SDL_Texture **tex)
+void closeSdlVars(SDL_Window **win, SDL_Renderer **ren, TTF_Font **fon, GlyphAtlas *atlas)
 {
-    SDL_FreeSurface(*surf);
-    SDL_DestroyTexture(*tex);
+    SDL_DestroyTexture(atlas->texture);
     TTF_CloseFont(*fon);
     SDL_DestroyRenderer(*ren);
     SDL_DestroyWindow(*win);
@@ -113,6 +113,129 @@ void closeSdlVars(SDL_Window **win, SDL_Renderer **ren, TTF_Font **fon, SDL_Surf
     SDL_Quit();
 }
 
+int columnsForWidth(int width, int npoints)
+{
+
+    const int columns = width - 2 * WIDTH_OFFSET;
+
+    if (columns < 1)
+    {
+        return 1;
+    }
+
+    return (npoints < columns) ? npoints : columns;
+}
+
+void initGlyphAtlas(SDL_Renderer *ren, TTF_Font *fon, SDL_Color color, GlyphAtlas *atlas)
+{
+
+    SDL_Surface *glyphs[ATLAS_GLYPHS];
+    SDL_Surface *sheet;
+    int i, width = 0;
+
+    atlas->height = TTF_FontHeight(fon);
+
+    // render every glyph once
+    for (i = 0; i < ATLAS_GLYPHS; i++)
+    {
+        glyphs[i] = TTF_RenderGlyph_Blended(fon, ATLAS_FIRST_GLYPH + i, color);
+        if (glyphs[i] == NULL)
+        {
+            printf("TTF_RenderGlyph_Blended Error: %s\n", TTF_GetError());
+            exit(EXIT_FAILURE);
+        }
+
+        atlas->glyphs[i].x = width;
+        atlas->glyphs[i].y = 0;
+        atlas->glyphs[i].w = glyphs[i]->w;
+        atlas->glyphs[i].h = glyphs[i]->h;
+        width += glyphs[i]->w;
+
+        if (glyphs[i]->h > atlas->height)
+        {
+            atlas->height = glyphs[i]->h;
+        }
+    }
+
+    // and copy them side by side into one texture
+    sheet = SDL_CreateRGBSurfaceWithFormat(0, width, atlas->height, 32, SDL_PIXELFORMAT_RGBA32);
+    if (sheet == NULL)
+    {
+        printf("SDL_CreateRGBSurfaceWithFormat Error: %s\n", SDL_GetError());
+        exit(EXIT_FAILURE);
+    }
+
+    for (i = 0; i < ATLAS_GLYPHS; i++)
+    {
+        SDL_Rect target = atlas->glyphs[i];
+
+        // keep the alpha of the glyph instead of blending it onto the empty sheet
+        SDL_SetSurfaceBlendMode(glyphs[i], SDL_BLENDMODE_NONE);
+        SDL_BlitSurface(glyphs[i], NULL, sheet, &target);
+        SDL_FreeSurface(glyphs[i]);
+    }
+
+    atlas->texture = SDL_CreateTextureFromSurface(ren, sheet);
+    SDL_FreeSurface(sheet);
+
+    if (atlas->texture == NULL)
+    {
+        printf("SDL_CreateTextureFromSurface Error: %s\n", SDL_GetError());
+        exit(EXIT_FAILURE);
+    }
+
+    SDL_SetTextureBlendMode(atlas->texture, SDL_BLENDMODE_BLEND);
+}
+
+int textWidth(const GlyphAtlas *atlas, const char *text)
+{
+
+    int width = 0;
+
+    for (; *text != '\0'; text++)
+    {
+        const int glyph = (*text >= ATLAS_FIRST_GLYPH && *text < ATLAS_FIRST_GLYPH + ATLAS_GLYPHS) ? *text - ATLAS_FIRST_GLYPH : '?' - ATLAS_FIRST_GLYPH;
+        width += atlas->glyphs[glyph].w;
+    }
+
+    return width;
+}
+
+void drawText(SDL_Renderer *ren, const GlyphAtlas *atlas, const char *text, int x, int y)
+{
+
+    for (; *text != '\0'; text++)
+    {
+        const int glyph = (*text >= ATLAS_FIRST_GLYPH && *text < ATLAS_FIRST_GLYPH + ATLAS_GLYPHS) ? *text - ATLAS_FIRST_GLYPH : '?' - ATLAS_FIRST_GLYPH;
+        SDL_Rect target = {x, y, atlas->glyphs[glyph].w, atlas->glyphs[glyph].h};
+
+        SDL_RenderCopy(ren, atlas->texture, &atlas->glyphs[glyph], &target);
+        x += target.w;
+    }
+}
+
+void drawHud(SDL_Renderer *ren, const GlyphAtlas *atlas, int step, double stepsPerSecond, double nsPerPoint, double fps, double renderMs, double energy)
+{
+
+    char text[HUD_TEXT_LENGTH];
+    int y = TEXT_OFFSET;
+
+    snprintf(text, sizeof(text), "step %d", step);
+    drawText(ren, atlas, text, TEXT_OFFSET, y);
+    y += atlas->height;
+
+    snprintf(text, sizeof(text), "%.0f steps/s, %.3f ns/point", stepsPerSecond, nsPerPoint);
+    drawText(ren, atlas, text, TEXT_OFFSET, y);
+    y += atlas->height;
+
+    snprintf(text, sizeof(text), "%.1f fps, render %.2f ms", fps, renderMs);
+    drawText(ren, atlas, text, TEXT_OFFSET, y);
+    y += atlas->height;
+
+    snprintf(text, sizeof(text), "energy %.6g", energy);
+    drawText(ren, atlas, text, TEXT_OFFSET, y);
+}
+
 void doGraphics()
 {
 
@@ -125,8 +248,6 @@ void doGraphics()
     // the text font
     TTF_Font *font = NULL;
 
-    SDL_Rect textrect = {0, 0, 0, 0};
-
     int w = MY_WINDOW_WIDTH;
     int h = MY_WINDOW_HEIGHT;
 
@@ -138,254 +259,321 @@ void doGraphics()
     // time counter
     int currentTimeStep = 1;
 
-    // init status texture
+    // all text is drawn from the glyph atlas
     const SDL_Color textColor = {0, 255, 0};
-    int texW, texH;
+    GlyphAtlas atlas;
 
-    SDL_Surface *textSurface = NULL;
-    SDL_Texture *pauseTexture = NULL;
+    // the events the master collects and the ones all processes apply, both start out the same everywhere
+    ControlEvents pending = {1, 0, 0, columnsForWidth(w, npoints), 1};
+    ControlEvents control = pending;
+    ControlEvents received = pending;
+    MPI_Request controlRequest = MPI_REQUEST_NULL;
+    int arrived = 1;
 
     // status flags
-    int run = 1;
-    int doPause = 0;
     int showAxis = 0;
-    int wasReset = 0;
 
     // damping factor
     double z = 1.0;
 
-    // current wave values
-    double *currentSimulationStep;
-    double prev, now;
+    // decimated wave values
+    double *currentFrame;
+
+    // the line through the minimum and maximum of all columns, drawn with a single call
+    SDL_Point *linePoints = NULL;
+    int pointsCapacity = 0;
+
+    // performance counters of the HUD, the rates are updated every STATS_INTERVAL
+    Uint32 statsTick = SDL_GetTicks();
+    Uint64 renderStart, renderTicks = 0;
+    int framesDrawn = 0;
+    int statsStep = currentTimeStep;
+    double shownFps = 0.0, shownRenderMs = 0.0, shownStepsPerSecond = 0.0, shownNsPerPoint = 0.0;
 
     // variables for framerate
     const int fps = 21;
     const Uint32 ticksPerFrame = 1000 / fps;
 
-    static Uint32 lastFrameTick = 0;
-    Uint32 currentFrameTick, elapsedTicks;
+    Uint32 frameStartTick = 0, elapsedTicks;
 
     if (id == MASTER)
     {
         initSdlVars(&gWindow, &gRenderer, &font);
-
-        textSurface = TTF_RenderText_Solid(font, "Running", textColor);
-        pauseTexture = SDL_CreateTextureFromSurface(gRenderer, textSurface);
-
-        SDL_QueryTexture(pauseTexture, NULL, NULL, &texW, &texH);
-        textrect.x = w - texW - TEXT_OFFSET;
-        textrect.y = h - texH - TEXT_OFFSET;
-        textrect.w = texW;
-        textrect.h = texH;
+        initGlyphAtlas(gRenderer, font, textColor, &atlas);
     }
 
-    // main event loop
-    while (run)
+    // the events apply at agreed steps, between them all processes calculate without waiting,
+    // the first ones right away, every later one after the steps of the events before
+    int applyStep = currentTimeStep;
+    int steps = 0;
+    int frameStep = currentTimeStep;
+    int framePending = 0;
+
+    // main event loop, one time step or one exchange of events per iteration
+    while (control.run)
     {
-        if (id == MASTER)
+
+        // at the agreed step the next frame starts, so the last one must have arrived by then
+        if (framePending && (currentTimeStep == applyStep || testFrame()))
         {
-            static SDL_Event event;
+            finishFrame();
+            framePending = 0;
 
-            // poll for sdl events and handle them
-            while (SDL_PollEvent(&event))
+            if (id == MASTER)
             {
-                switch (event.type)
-                {
-
-                case SDL_QUIT:
-                    run = 0;
-                    break;
+                static SDL_Event event;
 
-                case SDL_KEYUP:
-
-                    switch (event.key.keysym.sym)
+                // poll for sdl events and handle them
+                while (SDL_PollEvent(&event))
+                {
+                    switch (event.type)
                     {
 
-                    case SDLK_q:
-                    case SDLK_ESCAPE:
-                        run = 0;
+                    case SDL_QUIT:
+                        pending.run = 0;
                         break;
 
-                    case SDLK_a:
-                        showAxis = !showAxis;
-                        break;
+                    case SDL_KEYUP:
 
-                    case SDLK_p:
-                        if (doPause)
-                        {
-                            textSurface = TTF_RenderText_Solid(font, "Running", textColor);
-                        }
-                        else
+                        switch (event.key.keysym.sym)
                         {
-                            textSurface = TTF_RenderText_Solid(font, "Paused", textColor);
-                        }
 
-                        doPause = !doPause;
-                        pauseTexture = SDL_CreateTextureFromSurface(gRenderer, textSurface);
+                        case SDLK_q:
+                        case SDLK_ESCAPE:
+                            pending.run = 0;
+                            break;
 
-                        SDL_QueryTexture(pauseTexture, NULL, NULL, &texW, &texH);
-                        textrect.w = texW;
-                        textrect.h = texH;
+                        case SDLK_a:
+                            showAxis = !showAxis;
+                            break;
 
-                        break;
+                        case SDLK_p:
+                            pending.pause = !pending.pause;
+                            break;
 
-                    case SDLK_r:
+                        case SDLK_r:
 
-                        wasReset = 1;
-                        if (doPause)
-                        {
-                            doPause = 0;
+                            pending.reset = 1;
+                            pending.pause = 0;
 
-                            textSurface = TTF_RenderText_Solid(font, "Running", textColor);
-                            pauseTexture = SDL_CreateTextureFromSurface(gRenderer, textSurface);
+                            break;
 
-                            SDL_QueryTexture(pauseTexture, NULL, NULL, &texW, &texH);
-                            textrect.w = texW;
-                            textrect.h = texH;
+                        default:
+                            break;
                         }
+                        break;
 
+                    case SDL_WINDOWEVENT:
+                        if (event.window.event == SDL_WINDOWEVENT_RESIZED)
+                        {
+                            SDL_Surface *content = SDL_GetWindowSurface(gWindow);
+
+                            SDL_GetWindowSize(gWindow, &w, &h);
+
+                            SDL_Rect rect = {0, 0, w, h};
+                            SDL_FillRect(content, &rect, 0x000000FF);
+
+                            SDL_UpdateWindowSurface(gWindow);
+
+                            pending.columns = columnsForWidth(w, npoints);
+                        }
                         break;
 
                     default:
                         break;
                     }
-                    break;
+                }
 
-                case SDL_WINDOWEVENT:
-                    if (event.window.event == SDL_WINDOWEVENT_RESIZED)
-                    {
-                        SDL_Surface *content = SDL_GetWindowSurface(gWindow);
+                renderStart = SDL_GetPerformanceCounter();
 
-                        SDL_GetWindowSize(gWindow, &w, &h);
+                // clear the screen
+                SDL_SetRenderDrawColor(gRenderer, 0, 0, 0, 255);
+                SDL_RenderClear(gRenderer);
 
-                        SDL_Rect rect = {0, 0, w, h};
-                        SDL_FillRect(content, &rect, 0x000000FF);
+                // draw x and y axis if needed
+                if (showAxis)
+                {
+                    SDL_SetRenderDrawColor(gRenderer, 255, 255, 255, 255);
+                    SDL_RenderDrawLine(gRenderer, WIDTH_OFFSET, (h / 2) - Y_AXIS_LENGTH, WIDTH_OFFSET, (h / 2) + Y_AXIS_LENGTH);
+                    SDL_RenderDrawLine(gRenderer, WIDTH_OFFSET, h / 2, 2 * WIDTH_OFFSET + control.columns, h / 2);
+                }
 
-                        SDL_UpdateWindowSurface(gWindow);
+                // get the current values and draw them
+                currentFrame = getFrame();
 
-                        textrect.x = w - texW - TEXT_OFFSET;
-                        textrect.y = h - texH - TEXT_OFFSET;
-                    }
-                    break;
+                // apply damping
+                z = exp((double)-frameStep * lambda);
 
-                default:
-                    break;
+                // only grows if the window does
+                if (2 * control.columns > pointsCapacity)
+                {
+                    pointsCapacity = 2 * control.columns;
+                    linePoints = (SDL_Point *) realloc(linePoints, pointsCapacity * sizeof(SDL_Point));
                 }
-            }
 
-            // framerate
-            currentFrameTick = SDL_GetTicks();
-            if (lastFrameTick == 0)
-            {
-                lastFrameTick = SDL_GetTicks();
+                // the range of every column, connected to its left neighbor
+                for (int c = 0; c < control.columns; ++c)
+                {
+                    linePoints[2 * c].x = c + WIDTH_OFFSET;
+                    linePoints[2 * c].y = currentFrame[2 * c] * z + (h / 2);
+                    linePoints[2 * c + 1].x = c + WIDTH_OFFSET;
+                    linePoints[2 * c + 1].y = currentFrame[2 * c + 1] * z + (h / 2);
+                }
+
+                // set color to green and draw the line through all points
+                SDL_SetRenderDrawColor(gRenderer, 0, 255, 0, 255);
+                SDL_RenderDrawLines(gRenderer, linePoints, 2 * control.columns);
+
+                // render all, the status shows the state the processes apply next
+                const char *status = pending.pause ? "Paused" : "Running";
+                drawText(gRenderer, &atlas, status, w - textWidth(&atlas, status) - TEXT_OFFSET, h - atlas.height - TEXT_OFFSET);
+                drawHud(gRenderer, &atlas, frameStep, shownStepsPerSecond, shownNsPerPoint, shownFps, shownRenderMs, getFrameEnergy());
+                SDL_RenderPresent(gRenderer);
+
+                renderTicks += SDL_GetPerformanceCounter() - renderStart;
+                framesDrawn++;
+
+                // update the rates from time to time
+                if (SDL_GetTicks() - statsTick >= STATS_INTERVAL)
+                {
+                    const Uint32 now = SDL_GetTicks();
+
+                    // a reset goes back to the first step
+                    shownStepsPerSecond = (currentTimeStep > statsStep) ? 1000.0 * (currentTimeStep - statsStep) / (now - statsTick) : 0.0;
+                    shownNsPerPoint = (shownStepsPerSecond > 0) ? 1E9 / (shownStepsPerSecond * npoints) : 0.0;
+                    shownFps = 1000.0 * framesDrawn / (now - statsTick);
+                    shownRenderMs = 1000.0 * renderTicks / SDL_GetPerformanceFrequency() / framesDrawn;
+
+                    statsTick = now;
+                    statsStep = currentTimeStep;
+                    renderTicks = 0;
+                    framesDrawn = 0;
+                }
             }
+        }
 
-            // clear the screen
-            SDL_SetRenderDrawColor(gRenderer, 0, 0, 0, 255);
-            SDL_RenderClear(gRenderer);
+        if (currentTimeStep != applyStep)
+        {
+            simulateOneTimeStep();
+            currentTimeStep++;
 
-            // draw x and y axis if needed
-            if (showAxis)
+            // let the MPI library progress the events, they are needed at the agreed step
+            if (!arrived)
             {
-                SDL_SetRenderDrawColor(gRenderer, 255, 255, 255, 255);
-                SDL_RenderDrawLine(gRenderer, WIDTH_OFFSET, (h / 2) - Y_AXIS_LENGTH, WIDTH_OFFSET, (h / 2) + Y_AXIS_LENGTH);
-                SDL_RenderDrawLine(gRenderer, WIDTH_OFFSET, h / 2, 2 * WIDTH_OFFSET + npoints, h / 2);
+                MPI_Test(&controlRequest, &arrived, MPI_STATUS_IGNORE);
             }
+            continue;
         }
 
-        MPI_Barrier(MPI_COMM_WORLD);
-        MPI_Bcast(&doPause, 1, MPI_INT, MASTER, MPI_COMM_WORLD);
-        MPI_Bcast(&wasReset, 1, MPI_INT, MASTER, MPI_COMM_WORLD);
+        // only waits if the events did not arrive during the steps
+        if (!arrived)
+        {
+            MPI_Wait(&controlRequest, MPI_STATUS_IGNORE);
+        }
+        control = received;
 
-        if (wasReset)
+        if (control.reset)
         {
             resetWave();
             currentTimeStep = 1;
-            wasReset = 0;
         }
 
-        // simulate one time step
-        if (!doPause)
+        // check if time is over
+        if (currentTimeStep == tpoints)
         {
-            simulateOneTimeStep();
-
-            collectWave();
-            MPI_Barrier(MPI_COMM_WORLD);
-
-            if (id == MASTER)
-            {
-                currentTimeStep++;
-            }
+            control.run = 0;
         }
 
-        if (id == MASTER)
+        if (!control.run)
         {
-            // get the current values and draw them
-            currentSimulationStep = getStep();
-
-            // apply damping
-            z = exp((double)-currentTimeStep * lambda);
-
-            for (int l = 1; l < npoints; ++l)
-            {
+            break;
+        }
 
-                prev = currentSimulationStep[l - 1] * z;
-                now = currentSimulationStep[l] * z;
+        // the frame shows the wave at the agreed step, it travels while the processes calculate
+        frameStep = currentTimeStep;
+        startFrame(control.columns);
+        framePending = 1;
 
-                // set color to green and draw line between point and its left neighbor
-                SDL_SetRenderDrawColor(gRenderer, 0, 255, 0, 255);
-                SDL_RenderDrawLine(gRenderer, l - 1 + WIDTH_OFFSET, prev + (h / 2), l + WIDTH_OFFSET, now + (h / 2));
-            }
+        if (id == MASTER)
+        {
 
-            // render all
-            SDL_RenderCopy(gRenderer, pauseTexture, NULL, &textrect);
-            SDL_RenderPresent(gRenderer);
+            // calculate as many steps per frame as fit into the framerate
+            elapsedTicks = SDL_GetTicks() - frameStartTick;
 
-            // check if time is over
-            // if timesteps was set to 0, this results in an endless loop
-            // because currentTimeStep starts at 1 and increases, while tpoints stays at 0
-            if (currentTimeStep == tpoints)
+            if (steps == 0)
             {
-                run = 0;
+                // paused, nothing to calculate, wait a little
+                if (elapsedTicks < ticksPerFrame)
+                {
+                    SDL_Delay(ticksPerFrame - elapsedTicks);
+                }
             }
-
-            // check framerate
-            if ((currentFrameTick - lastFrameTick) >= ticksPerFrame)
+            else if (elapsedTicks < ticksPerFrame && steps < MAX_STEPS_PER_FRAME)
             {
-                lastFrameTick = currentFrameTick;
+                pending.stepsPerFrame = 2 * steps;
             }
-            else
+            else if (elapsedTicks > 2 * ticksPerFrame && steps > 1)
             {
-                // "too fast", wait a little
-                elapsedTicks = currentFrameTick - lastFrameTick;
-                SDL_Delay(ticksPerFrame - elapsedTicks);
+                pending.stepsPerFrame = steps / 2;
             }
+
+            frameStartTick = SDL_GetTicks();
         }
 
-        MPI_Barrier(MPI_COMM_WORLD);
-        MPI_Bcast(&run, 1, MPI_INT, MASTER, MPI_COMM_WORLD);
+        // all processes know the events they just applied, so they agree on the next step
+        steps = control.pause ? 0 : control.stepsPerFrame;
+
+        // if timesteps was set to 0, this results in an endless loop
+        if (tpoints > 0 && steps > tpoints - currentTimeStep)
+        {
+            steps = tpoints - currentTimeStep;
+        }
+
+        applyStep = currentTimeStep + steps;
+
+        // the next events travel while the processes calculate
+        received = pending;
+        pending.reset = 0;
+        arrived = 0;
+        MPI_Ibcast(&received, sizeof(ControlEvents), MPI_BYTE, MASTER, getComm(), &controlRequest);
     }
 
     if (id == MASTER)
     {
         // quit the program
-        closeSdlVars(&gWindow, &gRenderer, &font, &textSurface, &pauseTexture);
+        free(linePoints);
+        closeSdlVars(&gWindow, &gRenderer, &font, &atlas);
     }
-    MPI_Barrier(MPI_COMM_WORLD);
+    MPI_Barrier(getComm());
 }
 
 int main(int argc, char **argv)
 {
 
-    // init mpi
-    MPI_Init(&argc, &argv);
+    int provided;
+
+    // init mpi, the OpenMP threads of a process never call mpi themselves
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
     MPI_Comm_rank(MPI_COMM_WORLD, &id);
     MPI_Comm_size(MPI_COMM_WORLD, &numberOfProcesses);
 
+    if (provided < MPI_THREAD_FUNNELED)
+    {
+        if (id == MASTER)
+        {
+            printf("[ERROR] The MPI library does not support MPI_THREAD_FUNNELED!\n");
+        }
+        MPI_Finalize();
+        return EXIT_FAILURE;
+    }
+
     // set mpi error handler
     MPI_Comm_set_errhandler(MPI_COMM_WORLD, MPI_ERRORS_RETURN);
 
-    getUserInputOrConfig(argc, argv, id, numberOfProcesses);
+    getUserInputOrConfig(argc, argv, numberOfProcesses);
+
+    // the processes may have been renumbered for the line layout
+    id = getRank();
 
     if (doBench())
     {
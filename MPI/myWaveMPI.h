@@ -52,6 +52,34 @@
  */
 #define Y_AXIS_LENGTH 256
 
+/**
+ * @def STATS_INTERVAL
+ * 
+ * Time in milliseconds between two updates of the rates in the HUD
+ */
+#define STATS_INTERVAL 1000
+
+/**
+ * @def ATLAS_FIRST_GLYPH
+ * 
+ * The first character in the glyph atlas, the printable ASCII characters follow
+ */
+#define ATLAS_FIRST_GLYPH ' '
+
+/**
+ * @def ATLAS_GLYPHS
+ * 
+ * The number of characters in the glyph atlas
+ */
+#define ATLAS_GLYPHS 95
+
+/**
+ * @def HUD_TEXT_LENGTH
+ * 
+ * The maximum length of a line in the HUD
+ */
+#define HUD_TEXT_LENGTH 64
+
 /**
  * @def DEFAULT_FONT_PATH
  * 
@@ -73,6 +101,38 @@
  */
 #define ICON_PATH "../psysIcon.png"
 
+/**
+ * @def MAX_STEPS_PER_FRAME
+ * 
+ * The maximum number of time steps calculated between two frames
+ */
+#define MAX_STEPS_PER_FRAME 1024
+
+/**
+ * @brief Control events of the visualisation, sent from the master to all processes
+ */
+typedef struct
+{
+    int run;                         /**< 0 stops all processes */
+    int pause;                       /**< 1 stops calculating, the frames continue */
+    int reset;                       /**< 1 resets the wave to the initial sine wave */
+    int columns;                     /**< number of columns of the frames */
+    int stepsPerFrame;               /**< number of time steps until the next events are applied, with one frame in between */
+} ControlEvents;
+
+/**
+ * @brief All printable characters of the font in one texture
+ *
+ * Text is drawn with one copy per character from here, so no surfaces or textures
+ * are created while the program runs.
+ */
+typedef struct
+{
+    SDL_Texture *texture;            /**< the glyphs side by side */
+    SDL_Rect glyphs[ATLAS_GLYPHS];   /**< position of every glyph in the texture */
+    int height;                      /**< height of a line of text */
+} GlyphAtlas;
+
 /**
   * @brief Initializes all needed SDL variables
   *
@@ -88,13 +148,70 @@ void initSdlVars(SDL_Window** win, SDL_Renderer** ren, TTF_Font** fon);
   * @param win pointer to the SDL_Window
   * @param ren pointer to the SDL_Renderer
   * @param fon pointer to the TTF_Font
-  * @param surf pointer to the SDL_Surface
-  * @param tex pointer to the SDL_Texture
+  * @param atlas pointer to the glyph atlas
   */
-void closeSdlVars(SDL_Window** win, SDL_Renderer** ren, TTF_Font** fon, SDL_Surface **surf, SDL_Texture **tex);
+void closeSdlVars(SDL_Window** win, SDL_Renderer** ren, TTF_Font** fon, GlyphAtlas *atlas);
+
+/**
+  * @brief Returns the number of columns of a frame for the given window width
+  *
+  * @param width the width of the window
+  * @param npoints the number of points on the line
+  *
+  * @return One column per pixel between the offsets, but at most one per point
+  */
+int columnsForWidth(int width, int npoints);
+
+/**
+  * @brief Renders all glyphs once and copies them into the texture of the atlas
+  *
+  * @param ren pointer to the SDL_Renderer
+  * @param fon pointer to the TTF_Font
+  * @param color the color of the text
+  * @param atlas the glyph atlas
+  */
+void initGlyphAtlas(SDL_Renderer *ren, TTF_Font *fon, SDL_Color color, GlyphAtlas *atlas);
+
+/**
+  * @brief Returns the width of a text drawn from the atlas
+  *
+  * @param atlas the glyph atlas
+  * @param text the text, characters missing in the atlas are drawn as '?'
+  *
+  * @return The width in pixels
+  */
+int textWidth(const GlyphAtlas *atlas, const char *text);
+
+/**
+  * @brief Draws a text from the atlas
+  *
+  * @param ren pointer to the SDL_Renderer
+  * @param atlas the glyph atlas
+  * @param text the text, characters missing in the atlas are drawn as '?'
+  * @param x left border of the text
+  * @param y upper border of the text
+  */
+void drawText(SDL_Renderer *ren, const GlyphAtlas *atlas, const char *text, int x, int y);
+
+/**
+  * @brief Draws the HUD with the state of the simulation and the performance counters
+  *
+  * @param ren pointer to the SDL_Renderer
+  * @param atlas the glyph atlas
+  * @param step the shown time step
+  * @param stepsPerSecond time steps per second since the last update
+  * @param nsPerPoint nanoseconds per point and time step since the last update
+  * @param fps frames per second since the last update
+  * @param renderMs mean time in milliseconds to draw and present a frame since the last update
+  * @param energy energy of the shown time step
+  */
+void drawHud(SDL_Renderer *ren, const GlyphAtlas *atlas, int step, double stepsPerSecond, double nsPerPoint, double fps, double renderMs, double energy);
 
 /**
   * @brief Visualizes the wave equation with the SDL library
+  *
+  * The processes calculate continuously and send decimated frames and the control events
+  * to each other in the background, see @c startFrame().
   */
 void doGraphics(void);
 
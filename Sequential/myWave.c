@@ -88,12 +88,12 @@ void initSdlVars(SDL_Window **win, SDL_Renderer **ren, TTF_Font **fon)
 
     // set window icon
     SDL_SetWindowIcon(*win, icon);
+    SDL_FreeSurface(icon);
 }
 
-void closeSdlVars(SDL_Window **win, SDL_Renderer **ren, TTF_Font **fon, SDL_Surface **surf, SDL_Texture **tex)
+void closeSdlVars(SDL_Window **win, SDL_Renderer **ren, TTF_Font **fon, GlyphAtlas *atlas)
 {
-    SDL_FreeSurface(*surf);
-    SDL_DestroyTexture(*tex);
+    SDL_DestroyTexture(atlas->texture);
     TTF_CloseFont(*fon);
     SDL_DestroyRenderer(*ren);
     SDL_DestroyWindow(*win);
@@ -102,6 +102,813 @@ void closeSdlVars(SDL_Window **win, SDL_Renderer **ren, TTF_Font **fon, SDL_Surf
     SDL_Quit();
 }
 
+void initGlyphAtlas(SDL_Renderer *ren, TTF_Font *fon, SDL_Color color, GlyphAtlas *atlas)
+{
+
+    SDL_Surface *glyphs[ATLAS_GLYPHS];
+    SDL_Surface *sheet;
+    int i, width = 0;
+
+    atlas->height = TTF_FontHeight(fon);
+
+    // render every glyph once
+    for (i = 0; i < ATLAS_GLYPHS; i++)
+    {
+        glyphs[i] = TTF_RenderGlyph_Blended(fon, ATLAS_FIRST_GLYPH + i, color);
+        if (glyphs[i] == NULL)
+        {
+            printf("TTF_RenderGlyph_Blended Error: %s\n", TTF_GetError());
+            exit(EXIT_FAILURE);
+        }
+
+        atlas->glyphs[i].x = width;
+        atlas->glyphs[i].y = 0;
+        atlas->glyphs[i].w = glyphs[i]->w;
+        atlas->glyphs[i].h = glyphs[i]->h;
+        width += glyphs[i]->w;
+
+        if (glyphs[i]->h > atlas->height)
+        {
+            atlas->height = glyphs[i]->h;
+        }
+    }
+
+    // and copy them side by side into one texture
+    sheet = SDL_CreateRGBSurfaceWithFormat(0, width, atlas->height, 32, SDL_PIXELFORMAT_RGBA32);
+    if (sheet == NULL)
+    {
+        printf("SDL_CreateRGBSurfaceWithFormat Error: %s\n", SDL_GetError());
+        exit(EXIT_FAILURE);
+    }
+
+    for (i = 0; i < ATLAS_GLYPHS; i++)
+    {
+        SDL_Rect target = atlas->glyphs[i];
+
+        // keep the alpha of the glyph instead of blending it onto the empty sheet
+        SDL_SetSurfaceBlendMode(glyphs[i], SDL_BLENDMODE_NONE);
+        SDL_BlitSurface(glyphs[i], NULL, sheet, &target);
+        SDL_FreeSurface(glyphs[i]);
+    }
+
+    atlas->texture = SDL_CreateTextureFromSurface(ren, sheet);
+    SDL_FreeSurface(sheet);
+
+    if (atlas->texture == NULL)
+    {
+        printf("SDL_CreateTextureFromSurface Error: %s\n", SDL_GetError());
+        exit(EXIT_FAILURE);
+    }
+
+    SDL_SetTextureBlendMode(atlas->texture, SDL_BLENDMODE_BLEND);
+}
+
+int textWidth(const GlyphAtlas *atlas, const char *text)
+{
+
+    int width = 0;
+
+    for (; *text != '\0'; text++)
+    {
+        const int glyph = (*text >= ATLAS_FIRST_GLYPH && *text < ATLAS_FIRST_GLYPH + ATLAS_GLYPHS) ? *text - ATLAS_FIRST_GLYPH : '?' - ATLAS_FIRST_GLYPH;
+        width += atlas->glyphs[glyph].w;
+    }
+
+    return width;
+}
+
+void drawText(SDL_Renderer *ren, const GlyphAtlas *atlas, const char *text, int x, int y)
+{
+
+    for (; *text != '\0'; text++)
+    {
+        const int glyph = (*text >= ATLAS_FIRST_GLYPH && *text < ATLAS_FIRST_GLYPH + ATLAS_GLYPHS) ? *text - ATLAS_FIRST_GLYPH : '?' - ATLAS_FIRST_GLYPH;
+        SDL_Rect target = {x, y, atlas->glyphs[glyph].w, atlas->glyphs[glyph].h};
+
+        SDL_RenderCopy(ren, atlas->texture, &atlas->glyphs[glyph], &target);
+        x += target.w;
+    }
+}
+
+void drawHud(SDL_Renderer *ren, const GlyphAtlas *atlas, int step, double stepsPerSecond, double nsPerPoint, double fps, double renderMs, double energy)
+{
+
+    char text[HUD_TEXT_LENGTH];
+    int y = TEXT_OFFSET;
+
+    snprintf(text, sizeof(text), "step %d", step);
+    drawText(ren, atlas, text, TEXT_OFFSET, y);
+    y += atlas->height;
+
+    snprintf(text, sizeof(text), "%.0f steps/s, %.3f ns/point", stepsPerSecond, nsPerPoint);
+    drawText(ren, atlas, text, TEXT_OFFSET, y);
+    y += atlas->height;
+
+    snprintf(text, sizeof(text), "%.1f fps, render %.2f ms", fps, renderMs);
+    drawText(ren, atlas, text, TEXT_OFFSET, y);
+    y += atlas->height;
+
+    snprintf(text, sizeof(text), "energy %.6g", energy);
+    drawText(ren, atlas, text, TEXT_OFFSET, y);
+}
+
+void initFrameBuffer(FrameBuffer *frames)
+{
+
+    for (int i = 0; i < 3; i++)
+    {
+        frames->values[i] = (double *) calloc(2 * MAX_FRAME_COLUMNS, sizeof(double));
+        frames->columns[i] = 0;
+        frames->viewFrom[i] = 0;
+        frames->viewLength[i] = 0;
+        frames->steps[i] = 0;
+        frames->energies[i] = 0.0;
+    }
+
+    frames->back = 0;
+    frames->front = 1;
+    SDL_AtomicSet(&frames->middle, 2);
+}
+
+void freeFrameBuffer(FrameBuffer *frames)
+{
+
+    for (int i = 0; i < 3; i++)
+    {
+        free(frames->values[i]);
+    }
+}
+
+void publishFrame(FrameBuffer *frames, int viewFrom, int viewLength, int columns, int step)
+{
+
+    decimateWave(viewFrom, viewFrom + viewLength, columns, frames->values[frames->back]);
+    frames->columns[frames->back] = columns;
+    frames->viewFrom[frames->back] = viewFrom;
+    frames->viewLength[frames->back] = viewLength;
+    frames->steps[frames->back] = step;
+    frames->energies[frames->back] = computeEnergy();
+
+    // the values must be written before the renderer can see the buffer
+    SDL_MemoryBarrierRelease();
+    frames->back = SDL_AtomicSet(&frames->middle, frames->back | FRAME_FRESH) & ~FRAME_FRESH;
+}
+
+int frameTaken(FrameBuffer *frames)
+{
+    return !(SDL_AtomicGet(&frames->middle) & FRAME_FRESH);
+}
+
+int acquireFrame(FrameBuffer *frames)
+{
+
+    if (frameTaken(frames))
+    {
+        return 0;
+    }
+
+    frames->front = SDL_AtomicSet(&frames->middle, frames->front) & ~FRAME_FRESH;
+    SDL_MemoryBarrierAcquire();
+
+    return 1;
+}
+
+int pushControl(ControlQueue *queue, int type, int value, int length)
+{
+
+    const int tail = SDL_AtomicGet(&queue->tail);
+    const int next = (tail + 1) % CONTROL_QUEUE_SIZE;
+
+    if (next == SDL_AtomicGet(&queue->head))
+    {
+        return 0;
+    }
+
+    queue->events[tail].type = type;
+    queue->events[tail].value = value;
+    queue->events[tail].length = length;
+
+    // the event must be written before the simulation can see it
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&queue->tail, next);
+
+    return 1;
+}
+
+void sendControl(ControlQueue *queue, int type, int value)
+{
+
+    // the simulation empties the queue between its batches, so a slot is free again soon
+    while (!pushControl(queue, type, value, 0))
+    {
+        SDL_Delay(1);
+    }
+}
+
+int popControl(ControlQueue *queue, ControlEvent *event)
+{
+
+    const int head = SDL_AtomicGet(&queue->head);
+
+    if (head == SDL_AtomicGet(&queue->tail))
+    {
+        return 0;
+    }
+
+    SDL_MemoryBarrierAcquire();
+    *event = queue->events[head];
+
+    SDL_AtomicSet(&queue->head, (head + 1) % CONTROL_QUEUE_SIZE);
+
+    return 1;
+}
+
+int columnsForWidth(int width, int npoints)
+{
+
+    int columns = width - 2 * WIDTH_OFFSET;
+
+    if (columns > MAX_FRAME_COLUMNS)
+    {
+        columns = MAX_FRAME_COLUMNS;
+    }
+
+    if (columns < 1)
+    {
+        return 1;
+    }
+
+    return (npoints < columns) ? npoints : columns;
+}
+
+int clampView(long viewFrom, int viewLength, int npoints)
+{
+
+    if (viewFrom > npoints - viewLength)
+    {
+        viewFrom = npoints - viewLength;
+    }
+
+    return (viewFrom < 0) ? 0 : (int) viewFrom;
+}
+
+Uint32 heatColor(double value)
+{
+
+    const int level = (int)(fabs(value) * 255 / Y_AXIS_LENGTH);
+    const Uint32 intensity = (level > 255) ? 255 : level;
+
+    return (value > 0) ? 0xFF000000 | (intensity << 16) : 0xFF000000 | intensity;
+}
+
+int compressFrame(const double *values, int columns, unsigned char *bytes, double *scale)
+{
+
+    double largest = 0.0;
+    int previous = 0, size = 0;
+    int i;
+
+    for (i = 0; i < 2 * columns; i++)
+    {
+        largest = (fabs(values[i]) > largest) ? fabs(values[i]) : largest;
+    }
+
+    *scale = (largest > 0.0) ? largest : 1.0;
+
+    for (i = 0; i < 2 * columns; i++)
+    {
+
+        // also catches values that are not a number
+        double scaled = values[i] / *scale * HISTORY_LEVELS;
+        if (!(scaled >= -HISTORY_LEVELS))
+        {
+            scaled = -HISTORY_LEVELS;
+        }
+        else if (scaled > HISTORY_LEVELS)
+        {
+            scaled = HISTORY_LEVELS;
+        }
+
+        const int level = (int) lrint(scaled);
+        const int delta = level - previous;
+
+        // small differences of both signs become small numbers: 0, -1, 1, -2, ... to 0, 1, 2, 3, ...
+        unsigned int rest = (delta >= 0) ? 2u * delta : 2u * -delta - 1;
+        previous = level;
+
+        while (rest >= 0x80)
+        {
+            bytes[size++] = (rest & 0x7F) | 0x80;
+            rest >>= 7;
+        }
+
+        bytes[size++] = rest;
+    }
+
+    return size;
+}
+
+void decompressFrame(const unsigned char *bytes, int columns, double scale, double *values)
+{
+
+    int level = 0;
+
+    for (int i = 0; i < 2 * columns; i++)
+    {
+
+        unsigned int rest = 0;
+        int shift = 0;
+
+        // the lower 7 bits come first, the highest bit is set if another byte follows
+        do
+        {
+            rest |= (unsigned int)(*bytes & 0x7F) << shift;
+            shift += 7;
+        } while (*bytes++ & 0x80);
+
+        level += (rest & 1) ? -(int)((rest + 1) / 2) : (int)(rest / 2);
+        values[i] = (double) level * scale / HISTORY_LEVELS;
+    }
+}
+
+void initWaterfallRows(WaterfallRows *rows)
+{
+
+    rows->pixels = (Uint32 *) malloc((size_t) WATERFALL_ROWS * MAX_FRAME_COLUMNS * sizeof(Uint32));
+    rows->columns = 0;
+    rows->viewFrom = 0;
+    rows->viewLength = 0;
+    rows->first = 0;
+    rows->count = 0;
+    rows->lock = SDL_CreateMutex();
+    SDL_AtomicSet(&rows->shown, 0);
+
+    if (rows->pixels == NULL)
+    {
+        printf("[ERROR] Could not allocate the rows of the waterfall!\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void freeWaterfallRows(WaterfallRows *rows)
+{
+
+    free(rows->pixels);
+    SDL_DestroyMutex(rows->lock);
+}
+
+void queueWaterfallRow(WaterfallRows *rows, const double *minMax, int columns, int viewFrom, int viewLength, double z)
+{
+
+    SDL_LockMutex(rows->lock);
+
+    // the rows of another part of the line do not fit to the new ones
+    if (columns != rows->columns || viewFrom != rows->viewFrom || viewLength != rows->viewLength)
+    {
+        rows->columns = columns;
+        rows->viewFrom = viewFrom;
+        rows->viewLength = viewLength;
+        rows->count = 0;
+    }
+
+    // a full ring loses its oldest row
+    if (rows->count == WATERFALL_ROWS)
+    {
+        rows->first = (rows->first + 1) % WATERFALL_ROWS;
+        rows->count--;
+    }
+
+    Uint32 *row = rows->pixels + (size_t) ((rows->first + rows->count) % WATERFALL_ROWS) * MAX_FRAME_COLUMNS;
+
+    // every column is coloured by its larger displacement
+    for (int c = 0; c < columns; ++c)
+    {
+        const double value = (fabs(minMax[2 * c]) > fabs(minMax[2 * c + 1])) ? minMax[2 * c] : minMax[2 * c + 1];
+        row[c] = heatColor(value * z);
+    }
+
+    rows->count++;
+
+    SDL_UnlockMutex(rows->lock);
+}
+
+void initHistory(History *history)
+{
+
+    history->bytes = (unsigned char *) malloc(HISTORY_BYTES);
+    history->pending = (double *) malloc(2 * MAX_FRAME_COLUMNS * sizeof(double));
+    history->first = 0;
+    history->count = 0;
+    history->firstNumber = 0;
+    history->end = 0;
+    history->generation = 0;
+    history->hasPending = 0;
+    history->done = 0;
+    history->lock = SDL_CreateMutex();
+    history->frameQueued = SDL_CreateCond();
+
+    if (history->bytes == NULL || history->pending == NULL)
+    {
+        printf("[ERROR] Could not allocate the history!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    history->thread = SDL_CreateThread(historyThread, "history", history);
+
+    if (history->thread == NULL)
+    {
+        printf("SDL_CreateThread Error: %s\n", SDL_GetError());
+        exit(EXIT_FAILURE);
+    }
+}
+
+void freeHistory(History *history)
+{
+
+    SDL_LockMutex(history->lock);
+    history->done = 1;
+    SDL_CondSignal(history->frameQueued);
+    SDL_UnlockMutex(history->lock);
+
+    SDL_WaitThread(history->thread, NULL);
+
+    free(history->bytes);
+    free(history->pending);
+    SDL_DestroyCond(history->frameQueued);
+    SDL_DestroyMutex(history->lock);
+}
+
+void clearHistory(History *history)
+{
+
+    SDL_LockMutex(history->lock);
+
+    // the numbers keep increasing, so old positions are not mistaken for new frames
+    history->firstNumber += history->count;
+    history->first = 0;
+    history->count = 0;
+    history->end = 0;
+    history->generation++;
+    history->hasPending = 0;
+
+    SDL_UnlockMutex(history->lock);
+}
+
+void queueHistoryFrame(History *history, const FrameBuffer *frames)
+{
+
+    const int front = frames->front;
+
+    SDL_LockMutex(history->lock);
+
+    memcpy(history->pending, frames->values[front], 2 * frames->columns[front] * sizeof(double));
+    history->pendingFrame.columns = frames->columns[front];
+    history->pendingFrame.viewFrom = frames->viewFrom[front];
+    history->pendingFrame.viewLength = frames->viewLength[front];
+    history->pendingFrame.step = frames->steps[front];
+    history->pendingFrame.energy = frames->energies[front];
+    history->hasPending = 1;
+
+    SDL_CondSignal(history->frameQueued);
+    SDL_UnlockMutex(history->lock);
+}
+
+int historyThread(void *data)
+{
+
+    History *history = (History *) data;
+
+    double *values = (double *) malloc(2 * MAX_FRAME_COLUMNS * sizeof(double));
+    unsigned char *bytes = (unsigned char *) malloc(6 * MAX_FRAME_COLUMNS);
+    HistoryFrame frame;
+    int generation;
+
+    while (1)
+    {
+
+        SDL_LockMutex(history->lock);
+
+        while (!history->hasPending && !history->done)
+        {
+            SDL_CondWait(history->frameQueued, history->lock);
+        }
+
+        if (history->done)
+        {
+            SDL_UnlockMutex(history->lock);
+            break;
+        }
+
+        frame = history->pendingFrame;
+        memcpy(values, history->pending, 2 * frame.columns * sizeof(double));
+        generation = history->generation;
+        history->hasPending = 0;
+
+        SDL_UnlockMutex(history->lock);
+
+        // the renderer can hand over the next frame meanwhile
+        frame.size = compressFrame(values, frame.columns, bytes, &frame.scale);
+
+        SDL_LockMutex(history->lock);
+
+        // frames from before clearHistory() are not stored
+        if (generation == history->generation)
+        {
+
+            // the frames behind the end are the oldest ones, if the new frame does not fit there it goes to the start
+            if (history->end + frame.size > HISTORY_BYTES)
+            {
+                while (history->count > 0 && history->frames[history->first].offset >= history->end)
+                {
+                    history->first = (history->first + 1) % HISTORY_FRAMES;
+                    history->count--;
+                    history->firstNumber++;
+                }
+
+                history->end = 0;
+            }
+
+            // drop the oldest frames in the way
+            while (history->count == HISTORY_FRAMES || (history->count > 0 && history->frames[history->first].offset >= history->end &&
+                                                         history->frames[history->first].offset < history->end + frame.size))
+            {
+                history->first = (history->first + 1) % HISTORY_FRAMES;
+                history->count--;
+                history->firstNumber++;
+            }
+
+            frame.offset = history->end;
+            memcpy(history->bytes + frame.offset, bytes, frame.size);
+            history->frames[(history->first + history->count) % HISTORY_FRAMES] = frame;
+            history->count++;
+            history->end += frame.size;
+        }
+
+        SDL_UnlockMutex(history->lock);
+    }
+
+    free(values);
+    free(bytes);
+
+    return 0;
+}
+
+void historyRange(History *history, int *oldest, int *newest)
+{
+
+    SDL_LockMutex(history->lock);
+    *oldest = history->firstNumber;
+    *newest = history->firstNumber + history->count - 1;
+    SDL_UnlockMutex(history->lock);
+}
+
+int loadHistoryFrame(History *history, int *number, double *values, HistoryFrame *frame)
+{
+
+    SDL_LockMutex(history->lock);
+
+    if (history->count == 0)
+    {
+        SDL_UnlockMutex(history->lock);
+        return 0;
+    }
+
+    if (*number < history->firstNumber)
+    {
+        *number = history->firstNumber;
+    }
+    else if (*number >= history->firstNumber + history->count)
+    {
+        *number = history->firstNumber + history->count - 1;
+    }
+
+    *frame = history->frames[(history->first + *number - history->firstNumber) % HISTORY_FRAMES];
+    decompressFrame(history->bytes + frame->offset, frame->columns, frame->scale, values);
+
+    SDL_UnlockMutex(history->lock);
+
+    return 1;
+}
+
+int simulationThread(void *data)
+{
+
+    SimulationLink *link = (SimulationLink *) data;
+    ControlEvent event;
+
+    // constant setting values
+    const int tpoints = getTpoints();
+    const int npoints = getNpoints();
+    const int stepsPerSecond = getStepsPerSecond();
+    const int stride = getWaterfallStride();
+    const double lambda = getLambda();
+    const Uint64 frequency = SDL_GetPerformanceFrequency();
+
+    // time counter
+    int currentTimeStep = 1;
+
+    // status flags
+    int run = 1;
+    int doPause = 0;
+    int hold = 0;
+    int newFrame = 1;
+
+    // the pyramid is only rebuilt if the values changed since the last frame
+    int newValues = 1;
+
+    // the renderer sends the new number of columns if the window changes its size
+    int columns = columnsForWidth(MY_WINDOW_WIDTH, npoints);
+
+    // and the shown part of the line if it is zoomed or moved
+    int viewFrom = 0;
+    int viewLength = npoints;
+
+    // steps per batch, adapted to SIMULATION_BATCH_TICKS
+    int batch = 1;
+    int steps;
+    int waterfallShown;
+    Uint64 batchStart;
+
+    // steps since the rate was last reset, for the target steps per second
+    Uint64 rateStart = SDL_GetPerformanceCounter();
+    long rateSteps = 0;
+
+    // a row of the waterfall, decimated at the shown part of the line
+    double *rowValues = (double *) malloc(2 * MAX_FRAME_COLUMNS * sizeof(double));
+
+    while (run)
+    {
+
+        // handle the events of the user between the steps
+        while (popControl(&link->controls, &event))
+        {
+
+            // the step the event takes effect at, so a replay gets the same values
+            if (link->record != NULL)
+            {
+                fprintf(link->record, "%d %d %d %d\n", currentTimeStep, event.type, event.value, event.length);
+            }
+
+            switch (event.type)
+            {
+
+            case CONTROL_QUIT:
+                run = 0;
+                break;
+
+            case CONTROL_PAUSE:
+                doPause = event.value;
+                break;
+
+            case CONTROL_RESET:
+                resetWave();
+                currentTimeStep = 1;
+                hold = 0;
+                newFrame = 1;
+                newValues = 1;
+                break;
+
+            case CONTROL_HOLD:
+                hold = event.value;
+                break;
+
+            case CONTROL_COLUMNS:
+                columns = event.value;
+                newFrame = 1;
+                break;
+
+            case CONTROL_VIEW:
+                viewFrom = event.value;
+                viewLength = event.length;
+                newFrame = 1;
+                break;
+
+            default:
+                break;
+            }
+
+            // the target rate starts again from now
+            rateStart = SDL_GetPerformanceCounter();
+            rateSteps = 0;
+        }
+
+        // if timesteps was set to 0, this results in an endless loop
+        steps = (doPause || currentTimeStep == tpoints) ? 0 : batch;
+
+        if (tpoints > 0 && steps > tpoints - currentTimeStep)
+        {
+            steps = tpoints - currentTimeStep;
+        }
+
+        // only as many steps as are due at the target rate
+        if (stepsPerSecond > 0 && steps > 0)
+        {
+
+            const long due = (long) ((double) (SDL_GetPerformanceCounter() - rateStart) / frequency * stepsPerSecond) - rateSteps;
+
+            if (due < steps)
+            {
+                steps = (due > 0) ? due : 0;
+            }
+        }
+
+        // while the waterfall is shown, a batch ends at its next row
+        waterfallShown = SDL_AtomicGet(&link->rows.shown);
+
+        if (waterfallShown && steps > stride - currentTimeStep % stride)
+        {
+            steps = stride - currentTimeStep % stride;
+        }
+
+        if (steps > 0)
+        {
+            batchStart = SDL_GetPerformanceCounter();
+
+            simulateTiledTimeSteps(steps, hold);
+            currentTimeStep += steps;
+            rateSteps += steps;
+            newFrame = 1;
+            newValues = 1;
+
+            // every stride steps a row, so the time axis of the waterfall is uniform
+            if (waterfallShown && currentTimeStep % stride == 0)
+            {
+                const int rowColumns = (columns < viewLength) ? columns : viewLength;
+
+                buildPyramid();
+                newValues = 0;
+
+                decimateWave(viewFrom, viewFrom + viewLength, rowColumns, rowValues);
+                queueWaterfallRow(&link->rows, rowValues, rowColumns, viewFrom, viewLength, exp((double)-currentTimeStep * lambda));
+            }
+
+            // as many steps as fit into the batch time, so the events are handled quickly
+            if (steps == batch)
+            {
+                const Uint64 batchTicks = (SDL_GetPerformanceCounter() - batchStart) * 1000 / frequency;
+
+                if (batchTicks < SIMULATION_BATCH_TICKS / 2 && batch < (1 << 20))
+                {
+                    batch *= 2;
+                }
+                else if (batchTicks > SIMULATION_BATCH_TICKS && batch > 1)
+                {
+                    batch /= 2;
+                }
+            }
+        }
+
+        // reducing the values is only worth it if the renderer took the last frame
+        // a new view alone is read from the old pyramid in O(columns)
+        if (newFrame && frameTaken(&link->frames))
+        {
+            if (newValues)
+            {
+                buildPyramid();
+                newValues = 0;
+            }
+
+            publishFrame(&link->frames, viewFrom, viewLength, (columns < viewLength) ? columns : viewLength, currentTimeStep);
+            newFrame = 0;
+        }
+
+        if (steps == 0)
+        {
+            // paused, finished or ahead of the target rate
+            SDL_Delay(1);
+        }
+    }
+
+    free(rowValues);
+
+    return 0;
+}
+
+void drawAxis(SDL_Renderer *ren, int columns, int h)
+{
+
+    SDL_SetRenderDrawColor(ren, 255, 255, 255, 255);
+    SDL_RenderDrawLine(ren, WIDTH_OFFSET, (h / 2) - Y_AXIS_LENGTH, WIDTH_OFFSET, (h / 2) + Y_AXIS_LENGTH);
+    SDL_RenderDrawLine(ren, WIDTH_OFFSET, h / 2, 2 * WIDTH_OFFSET + columns, h / 2);
+}
+
+void drawWave(SDL_Renderer *ren, SDL_Point *linePoints, const double *values, int columns, int h, double z)
+{
+
+    // the range of every column, connected to its left neighbor
+    for (int c = 0; c < columns; ++c)
+    {
+        linePoints[2 * c].x = c + WIDTH_OFFSET;
+        linePoints[2 * c].y = values[2 * c] * z + (h / 2);
+        linePoints[2 * c + 1].x = c + WIDTH_OFFSET;
+        linePoints[2 * c + 1].y = values[2 * c + 1] * z + (h / 2);
+    }
+
+    // set color to green and draw the line through all points
+    SDL_SetRenderDrawColor(ren, 0, 255, 0, 255);
+    SDL_RenderDrawLines(ren, linePoints, 2 * columns);
+}
+
 void doGraphics()
 {
 
@@ -127,34 +934,112 @@ void doGraphics()
     // time counter
     int currentTimeStep = 1;
 
-    // init status texture
+    // all text is drawn from the glyph atlas
     const SDL_Color textColor = {0, 255, 0};
-    int texW, texH;
-
-    SDL_Surface *textSurface = NULL;
-    SDL_Texture *pauseTexture = NULL;
+    GlyphAtlas atlas;
 
-    textSurface = TTF_RenderText_Solid(font, "Running", textColor);
-    pauseTexture = SDL_CreateTextureFromSurface(gRenderer, textSurface);
-
-    SDL_QueryTexture(pauseTexture, NULL, NULL, &texW, &texH);
-    SDL_Rect textrect = {w - texW - TEXT_OFFSET, h - texH - TEXT_OFFSET, texW, texH};
+    initGlyphAtlas(gRenderer, font, textColor, &atlas);
 
     // status flags
     int run = 1;
     int doPause = 0;
     int showAxis = 0;
+    int showWaterfall = 0;
     int hold = 0;
 
     // mouse click coordinates
-    int mX, mY;
+    int mX = 0, mY = 0;
+
+    // the shown part of the line, zoomed with the mouse wheel and moved by dragging with the right button
+    int viewFrom = 0;
+    int viewLength = npoints;
+    int dragging = 0;
+    int dragX = 0;
+
+    // the view and the width are sent once per frame, only their latest values count
+    int viewChanged = 0;
+    int columnsChanged = 0;
 
     // damping factor
     double z = 1.0;
 
-    // current wave values
-    double *currentSimulationStep;
-    double prev, now;
+    // the simulation runs on its own thread and hands over the frames
+    SimulationLink link;
+
+    SDL_AtomicSet(&link.controls.head, 0);
+    SDL_AtomicSet(&link.controls.tail, 0);
+    link.record = NULL;
+
+    if (getRecordFile()[0] != '\0')
+    {
+        link.record = fopen(getRecordFile(), "w");
+
+        if (link.record == NULL)
+        {
+            printf("[ERROR] Could not open file '%s'!\n", getRecordFile());
+            exit(EXIT_FAILURE);
+        }
+
+        fprintf(link.record, "%s %d\n", SESSION_MAGIC, npoints);
+        printf("Recording the session to %s\n", getRecordFile());
+    }
+
+    initFrameBuffer(&link.frames);
+    initWaterfallRows(&link.rows);
+    buildPyramid();
+    publishFrame(&link.frames, viewFrom, viewLength, columnsForWidth(w, npoints), currentTimeStep);
+
+    SDL_Thread *simulation = SDL_CreateThread(simulationThread, "simulation", &link);
+    if (simulation == NULL)
+    {
+        printf("SDL_CreateThread Error: %s\n", SDL_GetError());
+        closeSdlVars(&gWindow, &gRenderer, &font, &atlas);
+        exit(EXIT_FAILURE);
+    }
+
+    // current wave values, reduced to the minimum and maximum of every column
+    double *currentFrame = link.frames.values[link.frames.front];
+    int frameColumns = 0;
+    int frameFrom = 0;
+    int frameLength = npoints;
+    int column, low, high;
+
+    // the line through the minimum and maximum of all columns, drawn with a single call
+    SDL_Point *linePoints = (SDL_Point *) malloc(2 * MAX_FRAME_COLUMNS * sizeof(SDL_Point));
+
+    // the waterfall keeps the rows of the simulation in a streaming texture, the newest row is
+    // written above the last one, so the texture is a ring and is drawn in two parts
+    SDL_Texture *waterfallTexture = SDL_CreateTexture(gRenderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, MAX_FRAME_COLUMNS, WATERFALL_ROWS);
+    int waterfallRow = 0;
+    int waterfallFilled = 0;
+    int waterfallColumns = 0, waterfallFrom = 0, waterfallLength = 0;
+    int newFrame = 0;
+
+    if (waterfallTexture == NULL)
+    {
+        printf("SDL_CreateTexture Error: %s\n", SDL_GetError());
+    }
+
+    // the shown frames are kept compressed, the arrow keys go back and forth through them
+    History history;
+    HistoryFrame historyFrame;
+    double *historyValues = (double *) malloc(2 * MAX_FRAME_COLUMNS * sizeof(double));
+    int oldest, newest;
+    char statusText[HUD_TEXT_LENGTH];
+
+    // number of the shown frame of the history, -1 for the newest frame of the simulation
+    int scrub = -1;
+    int scrubChanged = 0;
+
+    initHistory(&history);
+
+    // performance counters of the HUD, the rates are updated every STATS_INTERVAL
+    Uint32 statsTick = SDL_GetTicks();
+    Uint64 renderStart, renderTicks = 0;
+    int framesDrawn = 0;
+    int statsStep = currentTimeStep;
+    double shownFps = 0.0, shownRenderMs = 0.0, shownStepsPerSecond = 0.0, shownNsPerPoint = 0.0;
+    double energy = link.frames.energies[link.frames.front];
 
     // variables for framerate
     const int fps = 21;
@@ -180,6 +1065,59 @@ void doGraphics()
                 run = 0;
                 break;
 
+            case SDL_KEYDOWN:
+
+                // the arrow keys repeat while held, so they are handled when pressed
+                switch (event.key.keysym.sym)
+                {
+
+                case SDLK_LEFT:
+                case SDLK_HOME:
+                    historyRange(&history, &oldest, &newest);
+                    if (newest < oldest)
+                    {
+                        break;
+                    }
+
+                    // going back pauses the simulation, so the history stays as it is
+                    if (scrub < 0)
+                    {
+                        scrub = newest;
+
+                        if (!doPause)
+                        {
+                            doPause = 1;
+                            sendControl(&link.controls, CONTROL_PAUSE, doPause);
+                        }
+                    }
+
+                    scrub = (event.key.keysym.sym == SDLK_HOME || scrub <= oldest) ? oldest : scrub - 1;
+                    scrubChanged = 1;
+                    break;
+
+                case SDLK_RIGHT:
+                    if (scrub >= 0)
+                    {
+                        // after the newest frame of the history comes the simulation again
+                        historyRange(&history, &oldest, &newest);
+                        scrub = (scrub < newest) ? scrub + 1 : -1;
+                        scrubChanged = 1;
+                    }
+                    break;
+
+                case SDLK_END:
+                    if (scrub >= 0)
+                    {
+                        scrub = -1;
+                        scrubChanged = 1;
+                    }
+                    break;
+
+                default:
+                    break;
+                }
+                break;
+
             case SDL_KEYUP:
 
                 switch (event.key.keysym.sym)
@@ -194,40 +1132,44 @@ void doGraphics()
                     showAxis = !showAxis;
                     break;
 
-                case SDLK_p:
-                    if (doPause)
-                    {
-                        textSurface = TTF_RenderText_Solid(font, "Running", textColor);
-                    }
-                    else
+                case SDLK_w:
+                    showWaterfall = !showWaterfall;
+                    SDL_AtomicSet(&link.rows.shown, showWaterfall);
+
+                    // the waterfall starts again, the simulation made no rows while it was hidden
+                    if (showWaterfall)
                     {
-                        textSurface = TTF_RenderText_Solid(font, "Paused", textColor);
+                        SDL_LockMutex(link.rows.lock);
+                        link.rows.count = 0;
+                        SDL_UnlockMutex(link.rows.lock);
+                        waterfallFilled = 0;
                     }
+                    break;
 
+                case SDLK_p:
                     doPause = !doPause;
-                    pauseTexture = SDL_CreateTextureFromSurface(gRenderer, textSurface);
-
-                    SDL_QueryTexture(pauseTexture, NULL, NULL, &texW, &texH);
-                    textrect.w = texW;
-                    textrect.h = texH;
+                    sendControl(&link.controls, CONTROL_PAUSE, doPause);
 
+                    // the simulation continues from its newest frame
+                    if (!doPause && scrub >= 0)
+                    {
+                        scrub = -1;
+                        scrubChanged = 1;
+                    }
                     break;
 
                 case SDLK_r:
-                    resetWave();
-                    currentTimeStep = 1;
+                    sendControl(&link.controls, CONTROL_RESET, 0);
                     hold = 0;
 
+                    clearHistory(&history);
+                    scrub = -1;
+                    scrubChanged = 1;
+
                     if (doPause)
                     {
                         doPause = 0;
-
-                        textSurface = TTF_RenderText_Solid(font, "Running", textColor);
-                        pauseTexture = SDL_CreateTextureFromSurface(gRenderer, textSurface);
-
-                        SDL_QueryTexture(pauseTexture, NULL, NULL, &texW, &texH);
-                        textrect.w = texW;
-                        textrect.h = texH;
+                        sendControl(&link.controls, CONTROL_PAUSE, doPause);
                     }
 
                     break;
@@ -239,10 +1181,25 @@ void doGraphics()
 
             case SDL_MOUSEBUTTONDOWN:
 
+                // the right button moves the view
+                if (event.button.button == SDL_BUTTON_RIGHT)
+                {
+                    dragging = 1;
+                    dragX = event.button.x;
+                    break;
+                }
+
+                // points are only picked on the line
+                if (showWaterfall)
+                {
+                    break;
+                }
+
                 // if already holding a point, release it
                 if (hold)
                 {
                     hold = 0;
+                    sendControl(&link.controls, CONTROL_HOLD, hold);
                     break;
                 }
 
@@ -250,13 +1207,75 @@ void doGraphics()
                 mX = event.button.x;
                 mY = event.button.y;
 
-                // check if click is "near" a point on the wave
-                if (mX - WIDTH_OFFSET < npoints && mX > WIDTH_OFFSET && abs(currentSimulationStep[mX - WIDTH_OFFSET] * z + (h / 2) - mY) < HOLD_TOLERANCE)
+                // check if click is "near" the wave in this column
+                column = mX - WIDTH_OFFSET;
+                if (column >= 0 && column < frameColumns)
+                {
+                    low = currentFrame[2 * column] * z + (h / 2);
+                    high = currentFrame[2 * column + 1] * z + (h / 2);
+
+                    // the point in the middle of the column
+                    const int point = frameFrom + (int)(((long)column * frameLength / frameColumns + (long)(column + 1) * frameLength / frameColumns) / 2);
+
+                    if (point > 0 && mY > low - HOLD_TOLERANCE && mY < high + HOLD_TOLERANCE)
+                    {
+                        // if yes, mark this point as "hold"
+                        hold = point;
+                        sendControl(&link.controls, CONTROL_HOLD, hold);
+                    }
+                }
+                break;
+
+            case SDL_MOUSEBUTTONUP:
+                if (event.button.button == SDL_BUTTON_RIGHT)
+                {
+                    dragging = 0;
+                }
+                break;
+
+            case SDL_MOUSEMOTION:
+                mX = event.motion.x;
+
+                if (dragging)
+                {
+                    // whole points only, the rest of the way is kept for the next motion
+                    const int shift = (int)((long)(mX - dragX) * viewLength / columnsForWidth(w, viewLength));
+
+                    if (shift != 0)
+                    {
+                        dragX = mX;
+                        viewFrom = clampView((long)viewFrom - shift, viewLength, npoints);
+                        viewChanged = 1;
+                    }
+                }
+                break;
+
+            case SDL_MOUSEWHEEL:
+            {
+                // the point under the mouse stays where it is
+                const int columns = columnsForWidth(w, viewLength);
+                const int anchor = (mX - WIDTH_OFFSET < 0) ? 0 : (mX - WIDTH_OFFSET < columns) ? mX - WIDTH_OFFSET : columns - 1;
+                const long anchorPoint = viewFrom + (long)anchor * viewLength / columns;
+
+                // at most all points, at least one point per pixel
+                if (event.wheel.y > 0)
+                {
+                    viewLength /= ZOOM_FACTOR;
+                }
+                else if (event.wheel.y < 0)
+                {
+                    viewLength = (viewLength > npoints / ZOOM_FACTOR) ? npoints : viewLength * ZOOM_FACTOR;
+                }
+
+                if (viewLength < columnsForWidth(w, npoints))
                 {
-                    // if yes, mark this point as "hold"
-                    hold = mX - WIDTH_OFFSET;
+                    viewLength = columnsForWidth(w, npoints);
                 }
+
+                viewFrom = clampView(anchorPoint - (long)anchor * viewLength / columnsForWidth(w, viewLength), viewLength, npoints);
+                viewChanged = 1;
                 break;
+            }
 
             case SDL_WINDOWEVENT:
                 if (event.window.event == SDL_WINDOWEVENT_RESIZED)
@@ -270,8 +1289,7 @@ void doGraphics()
 
                     SDL_UpdateWindowSurface(gWindow);
 
-                    textrect.x = w - texW - TEXT_OFFSET;
-                    textrect.y = h - texH - TEXT_OFFSET;
+                    columnsChanged = 1;
                 }
                 break;
 
@@ -280,6 +1298,17 @@ void doGraphics()
             }
         }
 
+        // if the queue is full, the view and the width follow with the next frame
+        if (viewChanged && pushControl(&link.controls, CONTROL_VIEW, viewFrom, viewLength))
+        {
+            viewChanged = 0;
+        }
+
+        if (columnsChanged && pushControl(&link.controls, CONTROL_COLUMNS, columnsForWidth(w, npoints), 0))
+        {
+            columnsChanged = 0;
+        }
+
         // framerate
         currentFrameTick = SDL_GetTicks();
         if (lastFrameTick == 0)
@@ -287,6 +1316,36 @@ void doGraphics()
             lastFrameTick = SDL_GetTicks();
         }
 
+        // the newest frame of the simulation, the last one again if there is none
+        newFrame = acquireFrame(&link.frames);
+        if (newFrame)
+        {
+            queueHistoryFrame(&history, &link.frames);
+        }
+
+        if ((newFrame || scrubChanged) && scrub < 0)
+        {
+            currentFrame = link.frames.values[link.frames.front];
+            frameColumns = link.frames.columns[link.frames.front];
+            frameFrom = link.frames.viewFrom[link.frames.front];
+            frameLength = link.frames.viewLength[link.frames.front];
+            currentTimeStep = link.frames.steps[link.frames.front];
+            energy = link.frames.energies[link.frames.front];
+        }
+        else if ((newFrame || scrubChanged) && loadHistoryFrame(&history, &scrub, historyValues, &historyFrame))
+        {
+            currentFrame = historyValues;
+            frameColumns = historyFrame.columns;
+            frameFrom = historyFrame.viewFrom;
+            frameLength = historyFrame.viewLength;
+            currentTimeStep = historyFrame.step;
+            energy = historyFrame.energy;
+        }
+
+        scrubChanged = 0;
+
+        renderStart = SDL_GetPerformanceCounter();
+
         // clear the screen
         SDL_SetRenderDrawColor(gRenderer, 0, 0, 0, 255);
         SDL_RenderClear(gRenderer);
@@ -294,39 +1353,101 @@ void doGraphics()
         // draw x and y axis if needed
         if (showAxis)
         {
-            SDL_SetRenderDrawColor(gRenderer, 255, 255, 255, 255);
-            SDL_RenderDrawLine(gRenderer, WIDTH_OFFSET, (h / 2) - Y_AXIS_LENGTH, WIDTH_OFFSET, (h / 2) + Y_AXIS_LENGTH);
-            SDL_RenderDrawLine(gRenderer, WIDTH_OFFSET, h / 2, 2 * WIDTH_OFFSET + npoints, h / 2);
+            drawAxis(gRenderer, frameColumns, h);
         }
 
-        // simulate one time step
-        if (!doPause)
-        {
-            simulateOneTimeStep(hold);
-            currentTimeStep++;
-        }
-
-        // get the current values and draw them
-        currentSimulationStep = getStep();
-
         // apply damping
         z = exp((double)-currentTimeStep * lambda);
 
-        for (int l = 1; l < npoints; ++l)
+        // all rows the simulation made since the last frame, the newest one at the top
+        if (waterfallTexture != NULL)
         {
+            SDL_LockMutex(link.rows.lock);
+
+            // the rows of another part of the line do not fit to the new ones
+            if (link.rows.count > 0 && (link.rows.columns != waterfallColumns || link.rows.viewFrom != waterfallFrom || link.rows.viewLength != waterfallLength))
+            {
+                waterfallColumns = link.rows.columns;
+                waterfallFrom = link.rows.viewFrom;
+                waterfallLength = link.rows.viewLength;
+                waterfallFilled = 0;
+            }
+
+            for (; link.rows.count > 0; link.rows.count--)
+            {
+                waterfallRow = (waterfallRow + WATERFALL_ROWS - 1) % WATERFALL_ROWS;
+                SDL_Rect rowRect = {0, waterfallRow, waterfallColumns, 1};
+                SDL_UpdateTexture(waterfallTexture, &rowRect, link.rows.pixels + (size_t) link.rows.first * MAX_FRAME_COLUMNS, waterfallColumns * sizeof(Uint32));
+                link.rows.first = (link.rows.first + 1) % WATERFALL_ROWS;
+
+                if (waterfallFilled < WATERFALL_ROWS)
+                {
+                    waterfallFilled++;
+                }
+            }
 
-            prev = currentSimulationStep[l - 1] * z;
-            now = currentSimulationStep[l] * z;
+            SDL_UnlockMutex(link.rows.lock);
+        }
 
-            // set color to green and draw line between point and its left neighbor
-            SDL_SetRenderDrawColor(gRenderer, 0, 255, 0, 255);
-            SDL_RenderDrawLine(gRenderer, l - 1 + WIDTH_OFFSET, prev + (h / 2), l + WIDTH_OFFSET, now + (h / 2));
+        if (showWaterfall)
+        {
+            // newest rows at the top, from the ring position to the end of the texture and then from its start
+            const int top = (h / 2) - Y_AXIS_LENGTH;
+            const int upper = (waterfallRow + waterfallFilled < WATERFALL_ROWS) ? waterfallFilled : WATERFALL_ROWS - waterfallRow;
+
+            SDL_Rect source = {0, waterfallRow, waterfallColumns, upper};
+            SDL_Rect target = {WIDTH_OFFSET, top, waterfallColumns, upper};
+            SDL_RenderCopy(gRenderer, waterfallTexture, &source, &target);
+
+            source.y = 0;
+            source.h = waterfallFilled - upper;
+            target.y = top + upper;
+            target.h = source.h;
+            SDL_RenderCopy(gRenderer, waterfallTexture, &source, &target);
+        }
+        else
+        {
+            drawWave(gRenderer, linePoints, currentFrame, frameColumns, h, z);
         }
 
         // render all
-        SDL_RenderCopy(gRenderer, pauseTexture, NULL, &textrect);
+        if (scrub >= 0)
+        {
+            historyRange(&history, &oldest, &newest);
+            snprintf(statusText, sizeof(statusText), "History %d/%d", scrub - oldest + 1, newest - oldest + 1);
+        }
+        else
+        {
+            snprintf(statusText, sizeof(statusText), "%s", doPause ? "Paused" : "Running");
+        }
+
+        drawText(gRenderer, &atlas, statusText, w - textWidth(&atlas, statusText) - TEXT_OFFSET, h - atlas.height - TEXT_OFFSET);
+        drawHud(gRenderer, &atlas, currentTimeStep, shownStepsPerSecond, shownNsPerPoint, shownFps, shownRenderMs, energy);
         SDL_RenderPresent(gRenderer);
 
+        renderTicks += SDL_GetPerformanceCounter() - renderStart;
+        framesDrawn++;
+
+        // update the rates from time to time
+        if (SDL_GetTicks() - statsTick >= STATS_INTERVAL)
+        {
+            const Uint32 now = SDL_GetTicks();
+
+            // the rate of the simulation, also while a frame of the history is shown
+            const int liveStep = link.frames.steps[link.frames.front];
+
+            // a reset goes back to the first step
+            shownStepsPerSecond = (liveStep > statsStep) ? 1000.0 * (liveStep - statsStep) / (now - statsTick) : 0.0;
+            shownNsPerPoint = (shownStepsPerSecond > 0) ? 1E9 / (shownStepsPerSecond * npoints) : 0.0;
+            shownFps = 1000.0 * framesDrawn / (now - statsTick);
+            shownRenderMs = 1000.0 * renderTicks / SDL_GetPerformanceFrequency() / framesDrawn;
+
+            statsTick = now;
+            statsStep = liveStep;
+            renderTicks = 0;
+            framesDrawn = 0;
+        }
+
         // check if time is over
         // if timesteps was set to 0, this results in an endless loop
         // because currentTimeStep starts at 1 and increases, while tpoints stays at 0
@@ -349,8 +1470,417 @@ void doGraphics()
         }
     }
 
+    // stop the simulation, the queue may be full for a moment
+    sendControl(&link.controls, CONTROL_QUIT, 0);
+    SDL_WaitThread(simulation, NULL);
+    freeFrameBuffer(&link.frames);
+    freeWaterfallRows(&link.rows);
+
+    if (link.record != NULL)
+    {
+        fclose(link.record);
+    }
+
+    freeHistory(&history);
+    free(historyValues);
+
     // quit the program
-    closeSdlVars(&gWindow, &gRenderer, &font, &textSurface, &pauseTexture);
+    free(linePoints);
+    SDL_DestroyTexture(waterfallTexture);
+    closeSdlVars(&gWindow, &gRenderer, &font, &atlas);
+}
+
+int queueRenderFrame(RenderQueue *queue, int step)
+{
+
+    int slot, number;
+
+    SDL_LockMutex(queue->lock);
+
+    if (queue->count == RENDER_QUEUE_SIZE)
+    {
+        queue->dropped++;
+        SDL_UnlockMutex(queue->lock);
+        return 0;
+    }
+
+    slot = (queue->head + queue->count) % RENDER_QUEUE_SIZE;
+    SDL_UnlockMutex(queue->lock);
+
+    // the encoders only read the waiting slots, so this one is filled without the lock
+    buildPyramid();
+    decimateWave(0, getNpoints(), queue->columns, queue->values[slot]);
+    queue->steps[slot] = step;
+
+    SDL_LockMutex(queue->lock);
+    number = queue->queued++;
+    queue->numbers[slot] = number;
+    queue->count++;
+    SDL_CondSignal(queue->frameQueued);
+    SDL_UnlockMutex(queue->lock);
+
+    // the images are numbered without gaps, the steps show where frames were dropped
+    fprintf(queue->index, "%d %d\n", number, step);
+
+    return 1;
+}
+
+int encoderThread(void *data)
+{
+
+    Encoder *encoder = (Encoder *) data;
+    RenderQueue *queue = encoder->queue;
+
+    const double lambda = getLambda();
+    const int columns = queue->columns;
+
+    char path[MAX_PATH_LENGTH + 16];
+    int step, number;
+
+    while (1)
+    {
+
+        // take the oldest frame, so the images are drawn about in order
+        SDL_LockMutex(queue->lock);
+
+        while (queue->count == 0 && !queue->done)
+        {
+            SDL_CondWait(queue->frameQueued, queue->lock);
+        }
+
+        if (queue->count == 0)
+        {
+            SDL_UnlockMutex(queue->lock);
+            break;
+        }
+
+        memcpy(encoder->values, queue->values[queue->head], 2 * columns * sizeof(double));
+        step = queue->steps[queue->head];
+        number = queue->numbers[queue->head];
+
+        queue->head = (queue->head + 1) % RENDER_QUEUE_SIZE;
+        queue->count--;
+
+        SDL_UnlockMutex(queue->lock);
+
+        // the same plot as in the window, with the axis
+        SDL_SetRenderDrawColor(encoder->renderer, 0, 0, 0, 255);
+        SDL_RenderClear(encoder->renderer);
+        drawAxis(encoder->renderer, columns, MY_WINDOW_HEIGHT);
+        drawWave(encoder->renderer, encoder->linePoints, encoder->values, columns, MY_WINDOW_HEIGHT, exp((double)-step * lambda));
+        SDL_RenderPresent(encoder->renderer);
+
+        if (queue->raw == NULL)
+        {
+            snprintf(path, sizeof(path), "%s_%06d.png", getRenderOutput(), number);
+
+            if (IMG_SavePNG(encoder->image, path) != 0)
+            {
+                printf("IMG_SavePNG Error: %s\n", SDL_GetError());
+            }
+        }
+        else
+        {
+
+            // the images must be in the stream in the order of their numbers
+            SDL_LockMutex(queue->lock);
+            while (queue->written != number)
+            {
+                SDL_CondWait(queue->imageWritten, queue->lock);
+            }
+            SDL_UnlockMutex(queue->lock);
+
+            for (int y = 0; y < encoder->image->h; y++)
+            {
+                const Uint32 *pixels = (const Uint32 *)((const Uint8 *) encoder->image->pixels + y * encoder->image->pitch);
+
+                for (int x = 0; x < encoder->image->w; x++)
+                {
+                    encoder->row[3 * x] = (pixels[x] >> 16) & 0xFF;
+                    encoder->row[3 * x + 1] = (pixels[x] >> 8) & 0xFF;
+                    encoder->row[3 * x + 2] = pixels[x] & 0xFF;
+                }
+
+                fwrite(encoder->row, 3, encoder->image->w, queue->raw);
+            }
+
+            SDL_LockMutex(queue->lock);
+            queue->written++;
+            SDL_CondBroadcast(queue->imageWritten);
+            SDL_UnlockMutex(queue->lock);
+        }
+    }
+
+    return 0;
+}
+
+void doHeadless()
+{
+
+    // constant setting values
+    const int tpoints = getTpoints();
+    const int npoints = getNpoints();
+    const int interval = getRenderInterval();
+    const char *output = getRenderOutput();
+    const size_t outputLength = strlen(output);
+    const size_t suffixLength = strlen(RAW_RENDER_SUFFIX);
+
+    char indexPath[MAX_PATH_LENGTH + 16];
+
+    RenderQueue queue;
+    Encoder encoders[ENCODER_THREADS];
+
+    // time counter
+    int currentTimeStep = 1;
+    int steps, i;
+
+    Uint64 start, simulated;
+
+    queue.columns = columnsForWidth(MY_WINDOW_WIDTH, npoints);
+    queue.head = 0;
+    queue.count = 0;
+    queue.queued = 0;
+    queue.dropped = 0;
+    queue.written = 0;
+    queue.done = 0;
+    queue.lock = SDL_CreateMutex();
+    queue.frameQueued = SDL_CreateCond();
+    queue.imageWritten = SDL_CreateCond();
+    queue.raw = NULL;
+
+    for (i = 0; i < RENDER_QUEUE_SIZE; i++)
+    {
+        queue.values[i] = (double *) malloc(2 * queue.columns * sizeof(double));
+    }
+
+    if (outputLength >= suffixLength && 0 == strcmp(output + outputLength - suffixLength, RAW_RENDER_SUFFIX))
+    {
+        queue.raw = fopen(output, "wb");
+
+        if (queue.raw == NULL)
+        {
+            printf("[ERROR] Could not open file '%s'!\n", output);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    snprintf(indexPath, sizeof(indexPath), "%s%s", output, RENDER_INDEX_SUFFIX);
+    queue.index = fopen(indexPath, "w");
+
+    if (queue.index == NULL)
+    {
+        printf("[ERROR] Could not open file '%s'!\n", indexPath);
+        exit(EXIT_FAILURE);
+    }
+
+    fprintf(queue.index, "# IMAGE STEP\n");
+
+    // every encoder draws into its own image with a software renderer
+    for (i = 0; i < ENCODER_THREADS; i++)
+    {
+        encoders[i].queue = &queue;
+        encoders[i].image = SDL_CreateRGBSurfaceWithFormat(0, MY_WINDOW_WIDTH, MY_WINDOW_HEIGHT, 32, SDL_PIXELFORMAT_RGB888);
+
+        if (encoders[i].image == NULL)
+        {
+            printf("SDL_CreateRGBSurfaceWithFormat Error: %s\n", SDL_GetError());
+            exit(EXIT_FAILURE);
+        }
+
+        encoders[i].renderer = SDL_CreateSoftwareRenderer(encoders[i].image);
+
+        if (encoders[i].renderer == NULL)
+        {
+            printf("SDL_CreateSoftwareRenderer Error: %s\n", SDL_GetError());
+            exit(EXIT_FAILURE);
+        }
+
+        encoders[i].values = (double *) malloc(2 * queue.columns * sizeof(double));
+        encoders[i].linePoints = (SDL_Point *) malloc(2 * queue.columns * sizeof(SDL_Point));
+        encoders[i].row = (Uint8 *) malloc(3 * MY_WINDOW_WIDTH);
+        encoders[i].thread = SDL_CreateThread(encoderThread, "encoder", &encoders[i]);
+
+        if (encoders[i].thread == NULL)
+        {
+            printf("SDL_CreateThread Error: %s\n", SDL_GetError());
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    printf("Rendering an image of %dx%d pixels every %d time steps to %s%s\n", MY_WINDOW_WIDTH, MY_WINDOW_HEIGHT, interval,
+           output, (queue.raw == NULL) ? "_*.png" : "");
+
+    start = SDL_GetPerformanceCounter();
+
+    // the first image shows the initial wave, the last one the final step
+    queueRenderFrame(&queue, currentTimeStep);
+
+    while (currentTimeStep < tpoints)
+    {
+        steps = (interval < tpoints - currentTimeStep) ? interval : tpoints - currentTimeStep;
+
+        simulateTiledTimeSteps(steps, 0);
+        currentTimeStep += steps;
+
+        queueRenderFrame(&queue, currentTimeStep);
+    }
+
+    simulated = SDL_GetPerformanceCounter();
+
+    // let the encoders finish the waiting frames
+    SDL_LockMutex(queue.lock);
+    queue.done = 1;
+    SDL_CondBroadcast(queue.frameQueued);
+    SDL_UnlockMutex(queue.lock);
+
+    for (i = 0; i < ENCODER_THREADS; i++)
+    {
+        SDL_WaitThread(encoders[i].thread, NULL);
+        SDL_DestroyRenderer(encoders[i].renderer);
+        SDL_FreeSurface(encoders[i].image);
+        free(encoders[i].values);
+        free(encoders[i].linePoints);
+        free(encoders[i].row);
+    }
+
+    printf("Time simulating: %f seconds, total: %f seconds\n", (double)(simulated - start) / SDL_GetPerformanceFrequency(),
+           (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency());
+    printf("Rendered %d images, %d dropped because the encoders were busy, time steps in %s\n", queue.queued, queue.dropped, indexPath);
+
+    fclose(queue.index);
+
+    if (queue.raw != NULL)
+    {
+        fclose(queue.raw);
+    }
+
+    for (i = 0; i < RENDER_QUEUE_SIZE; i++)
+    {
+        free(queue.values[i]);
+    }
+
+    SDL_DestroyCond(queue.imageWritten);
+    SDL_DestroyCond(queue.frameQueued);
+    SDL_DestroyMutex(queue.lock);
+}
+
+void doReplay()
+{
+
+    // constant setting values
+    const int tpoints = getTpoints();
+    const int npoints = getNpoints();
+    const char *path = getReplayFile();
+
+    ControlEvent event;
+    FILE *session;
+    char magic[sizeof(SESSION_MAGIC)];
+    int points, step;
+
+    // state of the simulation thread while it was recorded
+    int currentTimeStep = 1;
+    int hold = 0;
+    int run = 1;
+
+    int events = 0;
+    long stepsDone = 0;
+    Uint64 start;
+    double seconds;
+
+    session = fopen(path, "r");
+
+    if (session == NULL)
+    {
+        printf("[ERROR] Could not open file '%s'!\n", path);
+        exit(EXIT_FAILURE);
+    }
+
+    if (fscanf(session, "%11s %d", magic, &points) != 2 || 0 != strcmp(magic, SESSION_MAGIC))
+    {
+        printf("[ERROR] '%s' is not a recorded session!\n", path);
+        exit(EXIT_FAILURE);
+    }
+
+    // the held points are indices on the line
+    if (points != npoints)
+    {
+        printf("[ERROR] The session was recorded with %d points, not %d!\n", points, npoints);
+        exit(EXIT_FAILURE);
+    }
+
+    printf("Replaying the session from %s\n", path);
+
+    start = SDL_GetPerformanceCounter();
+
+    while (run && fscanf(session, "%d %d %d %d", &step, &event.type, &event.value, &event.length) == 4)
+    {
+
+        // the visualisation ends at the last time step
+        if (tpoints > 0 && step > tpoints)
+        {
+            step = tpoints;
+        }
+
+        if (step < currentTimeStep)
+        {
+            printf("[ERROR] The events in '%s' are not in order of their time steps!\n", path);
+            exit(EXIT_FAILURE);
+        }
+
+        // all steps up to the event at once
+        if (step > currentTimeStep)
+        {
+            simulateTiledTimeSteps(step - currentTimeStep, hold);
+            stepsDone += step - currentTimeStep;
+            currentTimeStep = step;
+        }
+
+        if (currentTimeStep == tpoints)
+        {
+            run = 0;
+            break;
+        }
+
+        events++;
+
+        switch (event.type)
+        {
+
+        case CONTROL_QUIT:
+            run = 0;
+            break;
+
+        case CONTROL_RESET:
+            resetWave();
+            currentTimeStep = 1;
+            hold = 0;
+            break;
+
+        case CONTROL_HOLD:
+            hold = event.value;
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    seconds = (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+
+    fclose(session);
+
+    if (run)
+    {
+        printf("The session ends without quitting, it was replayed up to time step %d\n", currentTimeStep);
+    }
+
+    printf("Replayed %d events and %ld time steps in %f seconds (%.3f ns per point and step)\n", events, stepsDone, seconds,
+           (stepsDone > 0) ? seconds * 1E9 / stepsDone / npoints : 0.0);
+
+    if (doPrintValues())
+    {
+        outputNew();
+    }
 }
 
 int main(int argc, char **argv)
@@ -364,14 +1894,41 @@ int main(int argc, char **argv)
         return EXIT_SUCCESS;
     }
 
-    if (showGui())
+    if (doTune())
+    {
+        performTuning();
+        return EXIT_SUCCESS;
+    }
+
+    if (getReplayFile()[0] != '\0')
+    {
+
+        initWaveConditions();
+
+        // the recorded session at full speed, without window
+        doReplay();
+    }
+    else if (getRenderInterval() > 0)
+    {
+
+        initWaveConditions();
+
+        // images instead of the window, e.g. on a cluster
+        doHeadless();
+    }
+    else if (showGui())
     {
 
         initWaveConditions();
 
         printf("\n Controls:\n\tA\t\ttoggle axis\n");
+        printf("\tW\t\ttoggle the waterfall of the last rows\n");
         printf("\tP\t\tpause / continue the visualisation\n");
         printf("\tR\t\treset to initial sine wave\n");
+        printf("\tMouse wheel\tzoom in / out at the mouse\n");
+        printf("\tRight drag\tmove the zoomed wave\n");
+        printf("\tLeft / Right\tgo back / forth through the shown frames\n");
+        printf("\tHome / End\toldest shown frame / back to the simulation\n");
         printf("\tQ / ESC\t\tquit the program\n");
 
         // start main graphics loop
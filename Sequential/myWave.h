@@ -52,6 +52,13 @@
  */
 #define Y_AXIS_LENGTH 256
 
+/**
+ * @def WATERFALL_ROWS
+ * 
+ * Represents the number of rows kept in the waterfall view, one pixel row each
+ */
+#define WATERFALL_ROWS (2 * Y_AXIS_LENGTH)
+
 /**
  * @def HOLD_TOLERANCE
  * 
@@ -67,6 +74,34 @@
  */
 #define HOLD_TOLERANCE 20
 
+/**
+ * @def STATS_INTERVAL
+ * 
+ * Time in milliseconds between two updates of the rates in the HUD
+ */
+#define STATS_INTERVAL 1000
+
+/**
+ * @def ATLAS_FIRST_GLYPH
+ * 
+ * The first character in the glyph atlas, the printable ASCII characters follow
+ */
+#define ATLAS_FIRST_GLYPH ' '
+
+/**
+ * @def ATLAS_GLYPHS
+ * 
+ * The number of characters in the glyph atlas
+ */
+#define ATLAS_GLYPHS 95
+
+/**
+ * @def HUD_TEXT_LENGTH
+ * 
+ * The maximum length of a line in the HUD
+ */
+#define HUD_TEXT_LENGTH 64
+
 /**
  * @def DEFAULT_FONT_PATH
  * 
@@ -88,6 +123,295 @@
  */
 #define ICON_PATH "../psysIcon.png"
 
+/**
+ * @def MAX_FRAME_COLUMNS
+ * 
+ * The maximum number of columns of a frame, wider windows show the wave with this many columns
+ */
+#define MAX_FRAME_COLUMNS 4096
+
+/**
+ * @def FRAME_FRESH
+ * 
+ * Flag in the middle index of the triple buffer, set while the frame there was not taken by the renderer
+ */
+#define FRAME_FRESH 4
+
+/**
+ * @def CONTROL_QUEUE_SIZE
+ * 
+ * Number of slots in the queue of control events, one of them always stays empty
+ */
+#define CONTROL_QUEUE_SIZE 64
+
+/**
+ * @def CONTROL_QUIT
+ * 
+ * Control event: stop the simulation thread
+ */
+#define CONTROL_QUIT 0
+
+/**
+ * @def CONTROL_PAUSE
+ * 
+ * Control event: pause (value 1) or continue (value 0) the simulation
+ */
+#define CONTROL_PAUSE 1
+
+/**
+ * @def CONTROL_RESET
+ * 
+ * Control event: reset to the initial sine wave
+ */
+#define CONTROL_RESET 2
+
+/**
+ * @def CONTROL_HOLD
+ * 
+ * Control event: hold the point at the index in the value, 0 releases it
+ */
+#define CONTROL_HOLD 3
+
+/**
+ * @def CONTROL_COLUMNS
+ * 
+ * Control event: the number of columns of the frames changed to the value
+ */
+#define CONTROL_COLUMNS 4
+
+/**
+ * @def CONTROL_VIEW
+ * 
+ * Control event: show the points from the value on, as many as the length
+ */
+#define CONTROL_VIEW 5
+
+/**
+ * @def ZOOM_FACTOR
+ * 
+ * Factor of the number of shown points for one step of the mouse wheel
+ */
+#define ZOOM_FACTOR 2
+
+/**
+ * @def SIMULATION_BATCH_TICKS
+ * 
+ * The simulation thread calculates as many steps at once as fit into this many milliseconds,
+ * afterwards it handles the control events and publishes a frame
+ */
+#define SIMULATION_BATCH_TICKS 10
+
+/**
+ * @def RENDER_QUEUE_SIZE
+ * 
+ * Number of frames that can wait for the encoder threads, further frames are dropped
+ */
+#define RENDER_QUEUE_SIZE 16
+
+/**
+ * @def RENDER_INDEX_SUFFIX
+ * 
+ * Appended to the output of the images for the index with the time step of every image
+ */
+#define RENDER_INDEX_SUFFIX ".steps"
+
+/**
+ * @def ENCODER_THREADS
+ * 
+ * Number of threads drawing and writing the images without window
+ */
+#define ENCODER_THREADS 4
+
+/**
+ * @def HISTORY_BYTES
+ * 
+ * Memory for the compressed frames of the history, the oldest frames are dropped if it is full
+ */
+#define HISTORY_BYTES (16 * 1024 * 1024)
+
+/**
+ * @def HISTORY_FRAMES
+ * 
+ * Maximum number of frames in the history
+ */
+#define HISTORY_FRAMES 8192
+
+/**
+ * @def HISTORY_LEVELS
+ * 
+ * Quantisation of the history, the largest displacement of a frame is stored as this number
+ */
+#define HISTORY_LEVELS 32767
+
+/**
+ * @def SESSION_MAGIC
+ * 
+ * First word of a recorded session, followed by the number of points
+ */
+#define SESSION_MAGIC "WAVESESSION"
+
+/**
+ * @brief Three buffers for the frames between the simulation and the rendering thread
+ *
+ * A frame holds the minimum and maximum of every column, see @c decimateWave(). The simulation writes into @c back, the renderer reads from @c front. Both swap their
+ * buffer atomically with the one in the middle, so neither ever waits for the other.
+ */
+typedef struct
+{
+    double *values[3];               /**< minimum and maximum of every column in every buffer */
+    int columns[3];                  /**< number of columns in every buffer */
+    int viewFrom[3];                 /**< first shown point in every buffer */
+    int viewLength[3];               /**< number of shown points in every buffer */
+    int steps[3];                    /**< time step of the values in every buffer */
+    double energies[3];              /**< energy of the wave in every buffer */
+    SDL_atomic_t middle;             /**< index of the buffer in the middle, with @c FRAME_FRESH if it was not taken yet */
+    int back;                        /**< index of the buffer of the simulation thread */
+    int front;                       /**< index of the buffer of the rendering thread */
+} FrameBuffer;
+
+/**
+ * @brief An event of the user for the simulation thread
+ */
+typedef struct
+{
+    int type;                        /**< one of the @c CONTROL_ events */
+    int value;                       /**< argument of the event */
+    int length;                      /**< number of points for @c CONTROL_VIEW, unused otherwise */
+} ControlEvent;
+
+/**
+ * @brief Queue of control events with one producer (renderer) and one consumer (simulation)
+ */
+typedef struct
+{
+    ControlEvent events[CONTROL_QUEUE_SIZE]; /**< ring of events */
+    SDL_atomic_t head;               /**< next event to read, only moved by the simulation thread */
+    SDL_atomic_t tail;               /**< next free slot, only moved by the rendering thread */
+} ControlQueue;
+
+/**
+ * @brief The newest rows of the waterfall view, decimated by the simulation every @c WATERFALL_STRIDE time steps
+ *
+ * If the renderer did not take the rows in time, the oldest ones are overwritten. They would have
+ * been pushed out of the waterfall by the newer ones in the same frame anyway, so every row stays
+ * the same number of time steps after the one before.
+ */
+typedef struct
+{
+    Uint32 *pixels;                  /**< ring of @c WATERFALL_ROWS rows with @c MAX_FRAME_COLUMNS colours each */
+    int columns;                     /**< number of columns of all rows */
+    int viewFrom;                    /**< first shown point of all rows */
+    int viewLength;                  /**< number of shown points of all rows */
+    int first;                       /**< slot of the oldest row */
+    int count;                       /**< number of rows the renderer did not take yet */
+    SDL_atomic_t shown;              /**< set by the renderer while the waterfall is shown, no rows are made otherwise */
+    SDL_mutex *lock;                 /**< protects the fields above, except @c shown */
+} WaterfallRows;
+
+/**
+ * @brief Everything the rendering thread shares with the simulation thread
+ */
+typedef struct
+{
+    FrameBuffer frames;              /**< frames from the simulation to the renderer */
+    ControlQueue controls;           /**< events from the renderer to the simulation */
+    WaterfallRows rows;              /**< rows of the waterfall from the simulation to the renderer */
+    FILE *record;                    /**< the simulation writes every event with its time step into it, NULL if not recorded */
+} SimulationLink;
+
+/**
+ * @brief Frames waiting for the encoder threads when rendering without window
+ *
+ * The simulation fills the slot after the waiting frames without holding the lock,
+ * so it never waits for the encoders. If all slots are taken, the frame is dropped.
+ */
+typedef struct
+{
+    double *values[RENDER_QUEUE_SIZE]; /**< minimum and maximum of every column in every slot */
+    int steps[RENDER_QUEUE_SIZE];    /**< time step of the frame in every slot */
+    int numbers[RENDER_QUEUE_SIZE];  /**< number of the image of the frame in every slot */
+    int columns;                     /**< number of columns of all frames */
+    int head;                        /**< slot of the oldest waiting frame */
+    int count;                       /**< number of waiting frames */
+    int queued;                      /**< number of frames queued so far */
+    int dropped;                     /**< number of frames dropped so far */
+    int written;                     /**< number of images written to the raw stream so far */
+    int done;                        /**< set after the last frame was queued */
+    SDL_mutex *lock;                 /**< protects the fields above, except the slot being filled */
+    SDL_cond *frameQueued;           /**< signalled when a frame was queued or the last one was */
+    SDL_cond *imageWritten;          /**< signalled when an image was written to the raw stream */
+    FILE *raw;                       /**< the raw RGB stream, NULL for PNG files */
+    FILE *index;                     /**< one line with the number and the time step of every image, so dropped frames are visible */
+} RenderQueue;
+
+/**
+ * @brief An encoder thread with its own image to draw into
+ */
+typedef struct
+{
+    RenderQueue *queue;              /**< the frames to draw */
+    SDL_Surface *image;              /**< the image of the current frame */
+    SDL_Renderer *renderer;          /**< software renderer drawing into the image */
+    double *values;                  /**< copy of the current frame */
+    SDL_Point *linePoints;           /**< the vertices of the line */
+    Uint8 *row;                      /**< one row of the image as RGB bytes for the raw stream */
+    SDL_Thread *thread;              /**< the thread itself */
+} Encoder;
+
+/**
+ * @brief Where to find a compressed frame of the history
+ */
+typedef struct
+{
+    int offset;                      /**< first byte of the frame in the history */
+    int size;                        /**< number of bytes of the frame */
+    int columns;                     /**< number of columns of the frame */
+    int viewFrom;                    /**< first shown point */
+    int viewLength;                  /**< number of shown points */
+    int step;                        /**< time step of the frame */
+    double scale;                    /**< displacement stored as @c HISTORY_LEVELS */
+    double energy;                   /**< energy of the wave at the step */
+} HistoryFrame;
+
+/**
+ * @brief The last frames shown in the window, compressed by their own thread
+ *
+ * The renderer hands every new frame over in @c pending, a frame still waiting there is replaced.
+ * The history thread compresses it and writes it behind the last one into @c bytes, which is used
+ * as a ring. Every frame gets an increasing number, so the renderer can keep its position while
+ * old frames are dropped.
+ */
+typedef struct
+{
+    unsigned char *bytes;            /**< the compressed frames, @c HISTORY_BYTES long */
+    HistoryFrame frames[HISTORY_FRAMES]; /**< ring of the stored frames, oldest first */
+    int first;                       /**< index of the oldest frame in @c frames */
+    int count;                       /**< number of stored frames */
+    int firstNumber;                 /**< number of the oldest frame */
+    int end;                         /**< first byte behind the newest frame */
+    int generation;                  /**< increased by @c clearHistory(), frames taken before are not stored */
+    double *pending;                 /**< minimum and maximum of every column of the waiting frame */
+    HistoryFrame pendingFrame;       /**< layout of the waiting frame, @c size is unused */
+    int hasPending;                  /**< whether a frame is waiting */
+    int done;                        /**< set when the thread shall stop */
+    SDL_mutex *lock;                 /**< protects all fields */
+    SDL_cond *frameQueued;           /**< signalled when a frame waits or the thread shall stop */
+    SDL_Thread *thread;              /**< the history thread */
+} History;
+
+/**
+ * @brief All printable characters of the font in one texture
+ *
+ * Text is drawn with one copy per character from here, so no surfaces or textures
+ * are created while the program runs.
+ */
+typedef struct
+{
+    SDL_Texture *texture;            /**< the glyphs side by side */
+    SDL_Rect glyphs[ATLAS_GLYPHS];   /**< position of every glyph in the texture */
+    int height;                      /**< height of a line of text */
+} GlyphAtlas;
+
 /**
   * @brief Initializes the main SDL variables
   *
@@ -103,14 +427,351 @@ void initSdlVars(SDL_Window** win, SDL_Renderer** ren, TTF_Font** fon);
   * @param win pointer to the SDL_Window
   * @param ren pointer to the SDL_Renderer
   * @param fon pointer to the TTF_Font
-  * @param surf pointer to the SDL_Surface
-  * @param tex pointer to the SDL_Texture
+  * @param atlas pointer to the glyph atlas
   */
-void closeSdlVars(SDL_Window** win, SDL_Renderer** ren, TTF_Font** fon, SDL_Surface **surf, SDL_Texture **tex);
+void closeSdlVars(SDL_Window** win, SDL_Renderer** ren, TTF_Font** fon, GlyphAtlas *atlas);
+
+/**
+  * @brief Renders all glyphs once and copies them into the texture of the atlas
+  *
+  * @param ren pointer to the SDL_Renderer
+  * @param fon pointer to the TTF_Font
+  * @param color the color of the text
+  * @param atlas the glyph atlas
+  */
+void initGlyphAtlas(SDL_Renderer *ren, TTF_Font *fon, SDL_Color color, GlyphAtlas *atlas);
+
+/**
+  * @brief Returns the width of a text drawn from the atlas
+  *
+  * @param atlas the glyph atlas
+  * @param text the text, characters missing in the atlas are drawn as '?'
+  *
+  * @return The width in pixels
+  */
+int textWidth(const GlyphAtlas *atlas, const char *text);
+
+/**
+  * @brief Draws a text from the atlas
+  *
+  * @param ren pointer to the SDL_Renderer
+  * @param atlas the glyph atlas
+  * @param text the text, characters missing in the atlas are drawn as '?'
+  * @param x left border of the text
+  * @param y upper border of the text
+  */
+void drawText(SDL_Renderer *ren, const GlyphAtlas *atlas, const char *text, int x, int y);
+
+/**
+  * @brief Draws the HUD with the state of the simulation and the performance counters
+  *
+  * @param ren pointer to the SDL_Renderer
+  * @param atlas the glyph atlas
+  * @param step the shown time step
+  * @param stepsPerSecond time steps per second since the last update
+  * @param nsPerPoint nanoseconds per point and time step since the last update
+  * @param fps frames per second since the last update
+  * @param renderMs mean time in milliseconds to draw and present a frame since the last update
+  * @param energy energy of the shown time step
+  */
+void drawHud(SDL_Renderer *ren, const GlyphAtlas *atlas, int step, double stepsPerSecond, double nsPerPoint, double fps, double renderMs, double energy);
+
+/**
+  * @brief Allocates the three buffers for the frames
+  *
+  * @param frames the triple buffer
+  */
+void initFrameBuffer(FrameBuffer *frames);
+
+/**
+  * @brief Frees the three buffers for the frames
+  *
+  * @param frames the triple buffer
+  */
+void freeFrameBuffer(FrameBuffer *frames);
+
+/**
+  * @brief Reduces the current values into the back buffer and swaps it into the middle
+  *
+  * Only called by the simulation thread.
+  *
+  * The pyramid of the values must be up to date, see @c buildPyramid().
+  *
+  * @param frames the triple buffer
+  * @param viewFrom first shown point
+  * @param viewLength number of shown points
+  * @param columns number of columns of the frame, at most @c viewLength
+  * @param step the time step of the values
+  */
+void publishFrame(FrameBuffer *frames, int viewFrom, int viewLength, int columns, int step);
+
+/**
+  * @brief Checks whether the renderer took the last published frame
+  *
+  * @param frames the triple buffer
+  *
+  * @return 1 if the renderer took it, 0 if it is still waiting in the middle
+  */
+int frameTaken(FrameBuffer *frames);
+
+/**
+  * @brief Swaps the newest frame into the front buffer, if there is one
+  *
+  * Only called by the rendering thread.
+  *
+  * @param frames the triple buffer
+  *
+  * @return 1 if the front buffer holds a new frame, 0 if it is unchanged
+  */
+int acquireFrame(FrameBuffer *frames);
+
+/**
+  * @brief Adds an event to the queue, only called by the rendering thread
+  *
+  * @param queue the control queue
+  * @param type one of the @c CONTROL_ events
+  * @param value argument of the event
+  * @param length number of points for @c CONTROL_VIEW, 0 otherwise
+  *
+  * @return 1 if the event was added, 0 if the queue is full
+  */
+int pushControl(ControlQueue *queue, int type, int value, int length);
+
+/**
+  * @brief Adds an event to the queue and waits while it is full, only called by the rendering thread
+  *
+  * Used for the events that change the state of the simulation and must not get lost.
+  *
+  * @param queue the control queue
+  * @param type one of the @c CONTROL_ events except @c CONTROL_VIEW
+  * @param value argument of the event
+  */
+void sendControl(ControlQueue *queue, int type, int value);
+
+/**
+  * @brief Takes the oldest event from the queue, only called by the simulation thread
+  *
+  * @param queue the control queue
+  * @param event the event that was taken
+  *
+  * @return 1 if there was an event, 0 if the queue is empty
+  */
+int popControl(ControlQueue *queue, ControlEvent *event);
+
+/**
+  * @brief Returns the number of columns of a frame for the given window width
+  *
+  * @param width the width of the window
+  * @param npoints the number of points on the line
+  *
+  * @return One column per pixel between the offsets, but at most one per point and @c MAX_FRAME_COLUMNS
+  */
+int columnsForWidth(int width, int npoints);
+
+/**
+  * @brief Moves the first shown point so the whole view lies on the line
+  *
+  * @param viewFrom the wanted first shown point, may be outside of the line
+  * @param viewLength number of shown points, at most @c npoints
+  * @param npoints the number of points on the line
+  *
+  * @return The nearest first point with all shown points on the line
+  */
+int clampView(long viewFrom, int viewLength, int npoints);
+
+/**
+  * @brief Returns the colour of a displacement in the waterfall view
+  *
+  * Positive values are red, negative ones blue, both the brighter the further from 0.
+  *
+  * @param value the displacement in pixels, @c Y_AXIS_LENGTH is full brightness
+  *
+  * @return The colour in @c SDL_PIXELFORMAT_ARGB8888
+  */
+Uint32 heatColor(double value);
+
+/**
+  * @brief Quantises a frame and stores the differences between neighbouring values
+  *
+  * The values are scaled to @c HISTORY_LEVELS and every difference to the value before is written as
+  * a variable length number with 7 bits per byte. Smooth waves need 1 or 2 bytes per value.
+  *
+  * @param values minimum and maximum of every column, interleaved
+  * @param columns number of columns of the frame
+  * @param bytes room for at least 6 bytes per column
+  * @param scale the displacement that was stored as @c HISTORY_LEVELS
+  *
+  * @return The number of bytes written
+  */
+int compressFrame(const double *values, int columns, unsigned char *bytes, double *scale);
+
+/**
+  * @brief Restores a frame written by @c compressFrame()
+  *
+  * @param bytes the compressed frame
+  * @param columns number of columns of the frame
+  * @param scale the displacement that was stored as @c HISTORY_LEVELS
+  * @param values minimum and maximum of every column, interleaved
+  */
+void decompressFrame(const unsigned char *bytes, int columns, double scale, double *values);
+
+/**
+  * @brief Allocates the rows of the waterfall view
+  *
+  * @param rows the rows of the waterfall
+  */
+void initWaterfallRows(WaterfallRows *rows);
+
+/**
+  * @brief Frees the rows of the waterfall view
+  *
+  * @param rows the rows of the waterfall
+  */
+void freeWaterfallRows(WaterfallRows *rows);
+
+/**
+  * @brief Adds the colours of a decimated frame as the newest row, only called by the simulation thread
+  *
+  * A row of another part of the line drops all rows the renderer did not take yet.
+  *
+  * @param rows the rows of the waterfall
+  * @param minMax minimum and maximum of every column, interleaved
+  * @param columns number of columns of the row
+  * @param viewFrom first shown point of the row
+  * @param viewLength number of shown points of the row
+  * @param z damping factor of the time step of the row
+  */
+void queueWaterfallRow(WaterfallRows *rows, const double *minMax, int columns, int viewFrom, int viewLength, double z);
+
+/**
+  * @brief Allocates the history and starts its thread
+  *
+  * @param history the history
+  */
+void initHistory(History *history);
+
+/**
+  * @brief Stops the thread of the history and frees it
+  *
+  * @param history the history
+  */
+void freeHistory(History *history);
+
+/**
+  * @brief Drops all frames of the history, including a waiting one
+  *
+  * @param history the history
+  */
+void clearHistory(History *history);
+
+/**
+  * @brief Hands the front buffer over to the history thread, only called by the rendering thread
+  *
+  * @param history the history
+  * @param frames the triple buffer
+  */
+void queueHistoryFrame(History *history, const FrameBuffer *frames);
+
+/**
+  * @brief Compresses the frames handed over with @c queueHistoryFrame() into the history
+  *
+  * @param data pointer to the @c History
+  *
+  * @return 0 when the history is freed
+  */
+int historyThread(void *data);
+
+/**
+  * @brief Returns the numbers of the oldest and the newest frame of the history
+  *
+  * @param history the history
+  * @param oldest number of the oldest frame
+  * @param newest number of the newest frame, less than @c oldest if the history is empty
+  */
+void historyRange(History *history, int *oldest, int *newest);
+
+/**
+  * @brief Restores a frame of the history
+  *
+  * @param history the history
+  * @param number the number of the frame, moved to the oldest one if it was dropped meanwhile
+  * @param values room for @c MAX_FRAME_COLUMNS columns
+  * @param frame layout of the restored frame
+  *
+  * @return 1 if the frame was restored, 0 if the history is empty
+  */
+int loadHistoryFrame(History *history, int *number, double *values, HistoryFrame *frame);
+
+/**
+  * @brief Runs the simulation, started as its own thread by @c doGraphics()
+  *
+  * Calculates as fast as possible or with @c getStepsPerSecond() steps per second, handles the control
+  * events between the steps and publishes a frame whenever the renderer took the last one.
+  *
+  * @param data the @c SimulationLink to the rendering thread
+  *
+  * @return always 0
+  */
+int simulationThread(void *data);
+
+/**
+  * @brief Draws the x and y axis
+  *
+  * @param ren the renderer
+  * @param columns number of columns of the frame
+  * @param h the height of the image
+  */
+void drawAxis(SDL_Renderer *ren, int columns, int h);
+
+/**
+  * @brief Draws a frame as a line through the minimum and maximum of every column
+  *
+  * @param ren the renderer
+  * @param linePoints array for the 2 * @c columns vertices of the line
+  * @param values minimum and maximum of every column, interleaved
+  * @param columns number of columns of the frame
+  * @param h the height of the image
+  * @param z damping factor of the values
+  */
+void drawWave(SDL_Renderer *ren, SDL_Point *linePoints, const double *values, int columns, int h, double z);
 
 /**
   * @brief Visualizes the wave equation with the SDL library
   */
 void doGraphics(void);
 
+/**
+  * @brief Reduces the current values into a free slot of the render queue
+  *
+  * Only called by the simulation, which never waits for the encoders.
+  *
+  * @param queue the render queue
+  * @param step the time step of the values
+  *
+  * @return 1 if the frame was queued, 0 if it was dropped because all slots are taken
+  */
+int queueRenderFrame(RenderQueue *queue, int step);
+
+/**
+  * @brief Draws the queued frames and writes them as PNG files or into the raw stream
+  *
+  * @param data pointer to the @c Encoder
+  *
+  * @return 0 after the last frame
+  */
+int encoderThread(void *data);
+
+/**
+  * @brief Simulates the wave without window and renders an image every @c getRenderInterval() steps
+  */
+void doHeadless(void);
+
+/**
+  * @brief Replays the session recorded to @c getReplayFile() without window
+  *
+  * The steps between two events are calculated at once at full speed. Holding a point and
+  * resetting change the values, the other events only changed the window and are skipped.
+  */
+void doReplay(void);
+
 #endif //__WAVE_H_
\ No newline at end of file
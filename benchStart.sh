@@ -7,7 +7,7 @@
 
 
 # all program types that will be benched
-declare -a progTypes=("Sequential MP MPI")
+declare -a progTypes=("Sequential" "MP" "MPI" "Hybrid")
 
 progSeq="./myWave"
 progMP="./myWaveMP"
@@ -16,6 +16,14 @@ progMPI="myWaveMPI"
 # different thread numbers for testing OpenMP and MPI
 declare -a numThreads=(2 3 4 5)
 
+# hybrid MPI+OpenMP layouts as RANKSxTHREADS: processes per node times threads per process
+declare -a hybridLayouts=("1x4" "2x2" "4x1")
+
+# MPI variants: halos are exchanged every GHOST_DEPTH (-g) steps,
+# with new messages for every exchange, persistent requests or one-sided puts (-m),
+# or without halo exchange by sharing the wave on one node (-w)
+declare -a mpiVariants=("-g 1" "-g 4" "-g 16" "-g 1 -m 1" "-g 1 -m 2" "-w 1")
+
 # different point sizes
 declare -a numberOfPoints=(1000 10000 100000 1000000 10000000)
 
@@ -39,7 +47,17 @@ function doStuff {
         elif [ "$1" = "MPI" ] 
         then
             prog=$progMPI
-            { mpiexec -np "$4" "$prog" -b "$2" "$3"; } 2>&1
+            for variant in "${mpiVariants[@]}"
+            do
+                { mpiexec -np "$4" "$prog" -b "$2" "$3" $variant; } 2>&1
+            done
+
+        elif [ "$1" = "Hybrid" ] 
+        then
+            prog=$progMPI
+            ranks=${4%x*}
+            threads=${4#*x}
+            { mpiexec --map-by ppr:"$ranks":node:pe="$threads" -x OMP_NUM_THREADS="$threads" "$prog" -b "$2" "$3"; } 2>&1
 
         else
         	echo "Program type not in [ ${progTypes[@]} ]"
@@ -60,7 +78,14 @@ echo "" >> benchmark/benchResults.txt
 ## now loop through the programs array
 for progType in "${progTypes[@]}"
 do
-	cd $progType
+	# the hybrid runs use the MPI program
+	progDir=$progType
+	if [ "$progType" = "Hybrid" ]
+	then
+		progDir="MPI"
+	fi
+
+	cd $progDir
 
 	echo "Building..."
 	make all
@@ -89,7 +114,13 @@ do
     else
 
     	# for MP and MPI, test different number of threads as well
-    	for threads in "${numThreads[@]}"
+    	threadList=("${numThreads[@]}")
+    	if [ "$progType" = "Hybrid" ]
+    	then
+    		threadList=("${hybridLayouts[@]}")
+    	fi
+
+    	for threads in "${threadList[@]}"
     	do
 
     		echo "============================================================================================" >> ../benchmark/benchResults.txt
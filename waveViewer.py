@@ -0,0 +1,119 @@
+#!/usr/bin/env python3
+
+# @file waveViewer.py
+# @author Chris Rebbelin s0548921
+# @date 2018-07-29
+# This script shows the frames a running wave program publishes into shared memory
+# (option -P) as a plot in the terminal. It can be started and stopped at any time
+# without disturbing the simulation.
+
+import argparse
+import mmap
+import os
+import shutil
+import struct
+import sys
+import time
+
+# layout of SharedWave and SharedFrame in core.h
+MAGIC = b"WAVESHM1"
+HEADER = struct.Struct("=8s6i")
+FRAME_HEADER = struct.Struct("=I3i")
+
+
+def attach(name):
+    """Maps the shared memory of the given name, waits until the program created it."""
+
+    path = os.path.join("/dev/shm", name.lstrip("/"))
+
+    while True:
+        try:
+            with open(path, "rb") as f:
+                memory = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+            if memory[:8] == MAGIC:
+                return memory
+            memory.close()
+        except (FileNotFoundError, ValueError):
+            pass
+        time.sleep(0.1)
+
+
+def readLatest(memory):
+    """Returns (step, values, finished) of the newest frame, values as (min, max) pairs."""
+
+    _, slots, maxColumns, _, latest, finished, _ = HEADER.unpack_from(memory, 0)
+    frameSize = FRAME_HEADER.size + 16 * maxColumns
+
+    while latest >= 0:
+        offset = HEADER.size + latest * frameSize
+
+        # sequence lock: odd while written, the copy is only valid if it did not change
+        sequence, step, columns, _ = FRAME_HEADER.unpack_from(memory, offset)
+        if sequence % 2 == 0:
+            values = struct.unpack_from("=%dd" % (2 * columns), memory, offset + FRAME_HEADER.size)
+            if struct.unpack_from("=I", memory, offset)[0] == sequence:
+                return step, list(zip(values[0::2], values[1::2])), finished
+
+        latest = HEADER.unpack_from(memory, 0)[4]
+
+    return None, [], finished
+
+
+def plot(step, values, scale):
+    """Draws the minimum and maximum of every terminal column."""
+
+    size = shutil.get_terminal_size()
+    width, height = size.columns, size.lines - 2
+    rows = [[" "] * width for _ in range(height)]
+
+    for x in range(width):
+        part = values[x * len(values) // width:max((x + 1) * len(values) // width, x * len(values) // width + 1)]
+        low = min(v[0] for v in part)
+        high = max(v[1] for v in part)
+
+        # larger values at the top
+        top = int((1 - high / scale) * (height - 1) / 2)
+        bottom = int((1 - low / scale) * (height - 1) / 2)
+
+        for y in range(max(top, 0), min(bottom, height - 1) + 1):
+            rows[y][x] = "*"
+
+    sys.stdout.write("\x1b[H\x1b[2J" + "\n".join("".join(r) for r in rows))
+    sys.stdout.write("\nstep %d, %d columns\n" % (step, len(values)))
+    sys.stdout.flush()
+
+
+def main():
+
+    parser = argparse.ArgumentParser(description="Shows the frames of a wave program started with -P NAME")
+    parser.add_argument("name", help="name of the shared memory, as given to -P")
+    parser.add_argument("-r", "--rate", type=float, default=20, help="frames per second to draw")
+    parser.add_argument("-s", "--scale", type=float, default=0, help="value at the top of the plot, 0 to scale to the first frame")
+    args = parser.parse_args()
+
+    memory = attach(args.name)
+    scale = args.scale
+    lastStep = None
+
+    while True:
+        step, values, finished = readLatest(memory)
+
+        if step is not None and step != lastStep:
+            if scale <= 0:
+                scale = max(max(abs(v[0]), abs(v[1])) for v in values) or 1
+            plot(step, values, scale)
+            lastStep = step
+
+        if finished:
+            break
+
+        time.sleep(1 / args.rate)
+
+    memory.close()
+
+
+if __name__ == "__main__":
+    try:
+        main()
+    except KeyboardInterrupt:
+        pass